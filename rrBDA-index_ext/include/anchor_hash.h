@@ -0,0 +1,119 @@
+#ifndef __ANCHOR_HASH_H_INCLUDED
+#define __ANCHOR_HASH_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+#include "utils.h"
+#include "krfp.h"
+#include "rolling_hash.h"
+
+namespace anchor_hash {
+
+enum kind { KR, PACKED };
+
+/* Karp-Rabin fingerprints of all k-mers of seq[0..n) under the base of kr, whose window must be k */
+inline void kr_fingerprints( const unsigned char * seq, INT n, const karp_rabin_hashing::rolling_hash &kr, uint64_t * FP )
+{
+	karp_rabin_hashing::fingerprints( seq, n, kr.get_window(), kr.get_base(), kr.power(), FP );
+}
+
+/* Invertible 64-bit mixer: xor with a seed, then xor-shifts and multiplications by odd constants, each of which is a bijection */
+inline uint64_t mix( uint64_t x, uint64_t seed, uint64_t mul1, uint64_t mul2 )
+{
+	x ^= seed;
+	x ^= x >> 31;
+	x *= mul1;
+	x ^= x >> 29;
+	x *= mul2;
+	x ^= x >> 32;
+	return x;
+}
+
+/* Ranks of all k-mers of seq[0..n) when a k-mer of bits-bit symbol ranks fits in a word: the packed k-mer is updated with a shift and a mask and ranked through the mixer. Equal k-mers get equal ranks and distinct k-mers distinct ones */
+inline void packed_fingerprints( const unsigned char * seq, INT n, uint64_t k, const unsigned char * rank, unsigned int bits, uint64_t mask, uint64_t seed, uint64_t mul1, uint64_t mul2, uint64_t * FP )
+{
+	uint64_t v = 0;
+	for( uint64_t i = 0; i + 1 < k; i++ )
+		v = ( v << bits ) | rank[seq[i]];
+
+	for( INT i = k - 1; i < n; i++ )
+	{
+		v = ( ( v << bits ) | rank[seq[i]] ) & mask;
+		FP[i-k+1] = mix( v, seed, mul1, mul2 );
+	}
+}
+
+/* The function ranking the k-mers of the windows. The packed policy is used whenever a k-mer of the (unmasked) alphabet fits in 64 bits, and Karp-Rabin fingerprints otherwise; both are random orders of the k-mers drawn from the Karp-Rabin base. Building the index and querying it must use the same policy. Each policy has its own kernel; the policy is switched on once per call, not per position */
+class policy
+{
+	kind type;
+	uint64_t k;
+	karp_rabin_hashing::rolling_hash kr;
+	unsigned char rank[256];
+	unsigned int bits;
+	uint64_t mask;
+	uint64_t seed;
+	uint64_t mul1;
+	uint64_t mul2;
+
+	static uint64_t splitmix( uint64_t x )
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+		x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBULL;
+		return x ^ ( x >> 31 );
+	}
+
+public:
+	/* alphabet_hist counts the symbols of the text and masked (possibly NULL) marks the symbols that take no part in the alphabet */
+	policy( uint64_t k, uint64_t base, const INT * alphabet_hist, const bool * masked ) : k( k ), kr( base, k )
+	{
+		unsigned int sigma = 0;
+		for( INT c = 0; c < 256; c++ )
+		{
+			rank[c] = 0;
+			if( alphabet_hist[c] > 0 && ( masked == NULL || !masked[c] ) )
+				rank[c] = sigma++;
+		}
+
+		bits = 1;
+		while( ( 1U << bits ) < sigma )
+			bits++;
+
+		mask = ( bits * k >= 64 ) ? ~( uint64_t ) 0 : ( ( uint64_t ) 1 << ( bits * k ) ) - 1;
+		seed = splitmix( base );
+		mul1 = splitmix( seed ) | 1;
+		mul2 = splitmix( mul1 ) | 1;
+
+		type = ( bits * k <= 64 ) ? PACKED : KR;
+	}
+
+	kind get_kind() const
+	{
+		return type;
+	}
+
+	void set_kind( kind t )
+	{
+		type = t;
+	}
+
+	std::string name() const
+	{
+		return type == PACKED ? "packed" : "kr";
+	}
+
+	/* Ranks of all k-mers of seq[0..n), FP[j] for seq[j..j+k) */
+	void fingerprints( const unsigned char * seq, INT n, uint64_t * FP ) const
+	{
+		if( type == PACKED )
+			packed_fingerprints( seq, n, k, rank, bits, mask, seed, mul1, mul2, FP );
+		else
+			kr_fingerprints( seq, n, kr, FP );
+	}
+};
+
+}  // namespace anchor_hash
+
+#endif  // __ANCHOR_HASH_H_INCLUDED
@@ -0,0 +1,159 @@
+#ifndef __BUILD_STRATEGY_H_INCLUDED
+#define __BUILD_STRATEGY_H_INCLUDED
+
+#include <cmath>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace build_strategy {
+
+/* The ways of building the compacted tries of the bd-anchors, which all give the same tries: SPARSE sorts the anchored suffixes by their fingerprints (ssa(), rrbda-index_int only), FULL scans the suffix and LCP arrays of the whole text built in memory by libdivsufsort, and EXTERNAL scans those built on disk by pSAscan and EM-SparsePhi (rrbda-index_ext only) */
+enum kind { AUTO, SPARSE, FULL, EXTERNAL };
+
+/* Seconds per unit of work of one direction on one core, fitted on random, repetitive and periodic texts of 0.8 to 30 MB: an anchored suffix in one round of ssa(), a text symbol in libdivsufsort and the Phi algorithm, a text symbol in pSAscan and EM-SparsePhi, and a text symbol in the scan of arrays already on disk */
+constexpr double sparse_seconds = 1.3e-6;
+constexpr double full_seconds = 0.3e-6;
+constexpr double external_seconds = 0.6e-6;
+constexpr double scan_seconds = 0.12e-6;
+
+/* Bytes of sorting one anchored suffix in ssa(), as SSA_BYTES_PER_SUFFIX of ssa.cc */
+constexpr double sparse_bytes = 96;
+
+struct estimate
+{
+	bool available;
+	double seconds;
+	double bytes;
+};
+
+/* What the choice depends on, for one order: the text length n, the number g of bd-anchors, the threads, the memory the choice may take besides the text and the anchors (in bytes), the fingerprint table memory (bytes per symbol) and the memory budget (bytes, 0 for none) of ssa(), the memory of the chunk fingerprints kept for ssa() (bytes, both directions), the RAM of the external tools (bytes), and whether the strategies are available and the external arrays already on disk */
+struct input
+{
+	INT n;
+	INT g;
+	INT threads;
+	double memory;
+	double fp_bytes;
+	double ssa_budget;
+	double chunk_bytes;
+	double ram_use;
+	bool sparse;
+	bool external;
+	bool external_ready;
+};
+
+inline std::string name( kind k )
+{
+	switch( k )
+	{
+		case SPARSE: return "sparse";
+		case FULL: return "full";
+		case EXTERNAL: return "external";
+		default: return "auto";
+	}
+}
+
+/* The strategy of a name, or AUTO for any other name */
+inline kind parse( const std::string &s )
+{
+	if( s == "sparse" ) return SPARSE;
+	if( s == "full" ) return FULL;
+	if( s == "external" ) return EXTERNAL;
+	return AUTO;
+}
+
+/* The memory the system can give without swapping: MemAvailable of /proc/meminfo, or the free pages if there is none */
+inline double available_memory()
+{
+	std::ifstream meminfo( "/proc/meminfo" );
+	std::string key;
+	double kb = 0;
+	while( meminfo >> key >> kb )
+	{
+		if( key == "MemAvailable:" )
+			return kb * 1024;
+		meminfo.ignore( 256, '\n' );
+	}
+	return ( double ) sysconf( _SC_AVPHYS_PAGES ) * sysconf( _SC_PAGESIZE );
+}
+
+/* The estimate of a strategy for both directions. With two threads or more the directions are built at the same time, so their memory adds up; ssa() runs on half of the threads each, while libdivsufsort and the external tools run on one */
+inline estimate cost( kind k, const input &in )
+{
+	estimate e = { false, 0, 0 };
+	double n = in.n;
+	double g = in.g;
+	double directions = ( in.threads > 1 ) ? 2 : 1;
+
+	if( k == SPARSE && in.sparse )
+	{
+		/* One round per halving of the initial fingerprint length n/g */
+		double rounds = std::log2( std::max( 2.0, n / g ) ) + 1;
+		double sorting = sparse_bytes * g;
+		double kept = 0;
+		/* Under the budget the buckets are sorted within it, and the SSA and LCP arrays of both directions are kept besides */
+		if( in.ssa_budget > 0 && in.ssa_budget < sorting )
+		{
+			sorting = in.ssa_budget;
+			kept = 2 * 2 * sizeof( INT ) * g;
+		}
+		e.available = true;
+		e.seconds = 2 * sparse_seconds * g * rounds / std::max( ( INT ) 1, in.threads );
+		e.bytes = directions * ( std::max( 2 * g * sizeof( uint64_t ), in.fp_bytes * n ) + sorting ) + in.chunk_bytes + kept;
+	}
+	else if( k == FULL )
+	{
+		/* The suffix array and the permuted LCP array, and the reversed text for the left direction */
+		e.available = true;
+		e.seconds = 2 * full_seconds * n / directions;
+		e.bytes = directions * 2 * sizeof( INT ) * n + n;
+	}
+	else if( k == EXTERNAL && in.external )
+	{
+		e.available = true;
+		e.seconds = 2 * ( in.external_ready ? scan_seconds : external_seconds ) * n;
+		e.bytes = in.external_ready ? 0 : in.ram_use;
+	}
+	return e;
+}
+
+/* The requested strategy if it is available, or else the fastest of those whose memory fits, and the one of least memory if none does; the estimates are reported */
+inline kind choose( const input &in, kind requested )
+{
+	const kind kinds[3] = { SPARSE, FULL, EXTERNAL };
+	kind best = AUTO;
+	kind smallest = AUTO;
+	estimate best_e = { false, 0, 0 };
+	estimate smallest_e = { false, 0, 0 };
+
+	for( int i = 0; i < 3; i++ )
+	{
+		estimate e = cost( kinds[i], in );
+		if( !e.available )
+			continue;
+		std::cout << "  " << name( kinds[i] ) << ": about " << e.seconds << " s and " << e.bytes / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+
+		if( e.bytes <= in.memory && ( best == AUTO || e.seconds < best_e.seconds ) )
+		{
+			best = kinds[i];
+			best_e = e;
+		}
+		if( smallest == AUTO || e.bytes < smallest_e.bytes )
+		{
+			smallest = kinds[i];
+			smallest_e = e;
+		}
+	}
+
+	if( requested != AUTO && cost( requested, in ).available )
+		return requested;
+	return ( best != AUTO ) ? best : smallest;
+}
+
+}  // namespace build_strategy
+
+#endif  // __BUILD_STRATEGY_H_INCLUDED
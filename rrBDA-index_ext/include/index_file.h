@@ -0,0 +1,194 @@
+#ifndef __INDEX_FILE_H_INCLUDED
+#define __INDEX_FILE_H_INCLUDED
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <algorithm>
+#include <sdsl/rmq_support.hpp>
+
+#include "utils.h"
+
+namespace index_file {
+
+/* The sections of an index file: the compacted tries of both directions, as g integers each, and the RMQ data structures over their LCP arrays, as sdsl serializes them */
+enum section { RSA, RLCP, LSA, LLCP, RRMQ, LRMQ, SECTIONS };
+
+static const char magic[8] = { 'R', 'R', 'B', 'D', 'A', 'I', 'D', 'X' };
+constexpr uint32_t version = 2;
+
+/* Sections start at page boundaries, so that the arrays are aligned wherever the file is mapped */
+constexpr uint64_t alignment = 4096;
+
+/* The header at the start of an index file, which holds the parameters the anchors were computed with and checksums of the text they were computed from, in the byte order of the machine that built it */
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t int_width;
+	uint64_t n;
+	uint64_t g;
+	uint64_t ell;
+	uint64_t k;
+	uint64_t base;
+	uint64_t policy;
+	uint64_t alphabet[4];
+	uint64_t text_checksum;
+	uint64_t sample_checksum;
+	uint64_t mask_checksum;
+	uint64_t offset[SECTIONS];
+	uint64_t bytes[SECTIONS];
+};
+
+constexpr uint64_t basis = 0xcbf29ce484222325ULL;
+constexpr uint64_t prime = 0x100000001b3ULL;
+
+/* A checksum of T[0..n): FNV-1a over the 8-byte words of blocks of 1 MiB, which are hashed in parallel, and then over the checksums of the blocks in order -- Time is O(n/threads) */
+inline uint64_t checksum( const unsigned char * T, INT n, INT threads )
+{
+	const INT block = 1 << 20;
+	INT blocks = ( n + block - 1 ) / block;
+	std::vector<uint64_t> block_sum( blocks );
+
+	#pragma omp parallel for num_threads( threads )
+	for( INT b = 0; b < blocks; b++ )
+	{
+		INT i = b * block;
+		INT end = std::min( n, i + block );
+		uint64_t h = basis;
+		for( ; i + 8 <= end; i += 8 )
+		{
+			uint64_t w;
+			memcpy( &w, T + i, 8 );
+			h = ( h ^ w ) * prime;
+		}
+		for( ; i < end; i++ )
+			h = ( h ^ T[i] ) * prime;
+		block_sum[b] = h;
+	}
+
+	uint64_t h = ( basis ^ ( uint64_t ) n ) * prime;
+	for( INT b = 0; b < blocks; b++ )
+		h = ( h ^ block_sum[b] ) * prime;
+	return h;
+}
+
+/* A checksum of 64 blocks of 4 KiB spread evenly over T[0..n), or of all of it if it is shorter, which tells texts apart without reading them whole -- Time is O(1) */
+inline uint64_t sample_checksum( const unsigned char * T, INT n )
+{
+	const INT samples = 64;
+	const INT length = 4096;
+	if( n <= samples * length )
+		return checksum( T, n, 1 );
+
+	uint64_t h = ( basis ^ ( uint64_t ) n ) * prime;
+	for( INT s = 0; s < samples; s++ )
+		h = ( h ^ checksum( T + s * ( ( n - length ) / ( samples - 1 ) ), length, 1 ) ) * prime;
+	return h;
+}
+
+/* Records in h the symbols occurring in the text, as counted by alphabet_hist */
+inline void store_alphabet( header &h, const INT * alphabet_hist )
+{
+	for( int c = 0; c < 256; c++ )
+		if( alphabet_hist[c] > 0 )
+			h.alphabet[c / 64] |= ( uint64_t ) 1 << ( c % 64 );
+}
+
+/* Sets alphabet_hist[c] to 1 for the symbols c occurring in the text of h and to 0 for the others, which is all the ranking policy needs of the histogram */
+inline void load_alphabet( const header * h, INT * alphabet_hist )
+{
+	for( int c = 0; c < 256; c++ )
+		alphabet_hist[c] = ( h->alphabet[c / 64] >> ( c % 64 ) ) & 1;
+}
+
+/* Writes the index file file_name: h describes the index, and its magic, version, width and sections are filled in here from the arrays RSA, RLCP, LSA and LLCP of h.g integers each and the two RMQ data structures. It is written under a temporary name and then renamed, so that no process ever maps a partial index */
+inline void write( const std::string &file_name, header h, const INT * const arrays[4], const sdsl::rmq_succinct_sct<> &rrmq, const sdsl::rmq_succinct_sct<> &lrmq )
+{
+	memcpy( h.magic, magic, sizeof( magic ) );
+	h.version = version;
+	h.int_width = sizeof( INT );
+
+	std::string tmp_name = file_name + ".tmp";
+	std::ofstream os( tmp_name, std::ios::binary | std::ios::trunc );
+	uint64_t end = sizeof( header );
+	for( int s = 0; s < SECTIONS; s++ )
+	{
+		h.offset[s] = ( ( end + alignment - 1 ) / alignment ) * alignment;
+		os.seekp( h.offset[s] );
+		if( s < RRMQ )
+			os.write( ( const char * ) arrays[s], h.g * sizeof( INT ) );
+		else
+			( s == RRMQ ? rrmq : lrmq ).serialize( os );
+		end = os.tellp();
+		h.bytes[s] = end - h.offset[s];
+	}
+	os.seekp( 0 );
+	os.write( ( const char * ) &h, sizeof( header ) );
+	os.close();
+
+	if( !os || std::rename( tmp_name.c_str(), file_name.c_str() ) != 0 )
+	{
+		fprintf( stderr, "Error: writing %s failed\n", file_name.c_str() );
+		std::exit( EXIT_FAILURE );
+	}
+}
+
+/* Maps the index file file_name read-only and shared, so that the processes serving an index share its pages, and returns its header, or NULL if it cannot be read or is not an index file of this version and width of INT; size gets the length of the mapping */
+inline const header * map( const std::string &file_name, uint64_t &size )
+{
+	long length = 0;
+	const header * h = ( const header * ) utils::file_map_shared( file_name, length );
+	if( h == NULL )
+		return NULL;
+	size = length;
+
+	bool valid = size >= sizeof( header ) && memcmp( h->magic, magic, sizeof( magic ) ) == 0 && h->version == version && h->int_width == sizeof( INT );
+	for( int s = 0; valid && s < SECTIONS; s++ )
+		valid = h->offset[s] % alignment == 0 && h->offset[s] <= size && h->bytes[s] <= size - h->offset[s] && ( s >= RRMQ || h->bytes[s] == h->g * sizeof( INT ) );
+
+	if( !valid )
+	{
+		utils::file_unmap_shared( ( const unsigned char * ) h, size );
+		return NULL;
+	}
+	return h;
+}
+
+inline void unmap( const header * h, uint64_t size )
+{
+	utils::file_unmap_shared( ( const unsigned char * ) h, size );
+}
+
+/* The integers of one of the sections RSA to LLCP, in place in the mapping */
+inline const INT * array( const header * h, section s )
+{
+	return ( const INT * ) ( ( const char * ) h + h->offset[s] );
+}
+
+/* Reads the bytes of a section in place */
+struct section_buffer : public std::streambuf
+{
+	section_buffer( const char * data, uint64_t bytes )
+	{
+		char * p = const_cast<char *>( data );
+		setg( p, p, p + bytes );
+	}
+};
+
+/* Loads the RMQ data structure of one of the sections RRMQ and LRMQ: sdsl structures own their memory, so its O(g) bits are the only part of an index copied out of the mapping */
+inline void load_rmq( const header * h, section s, sdsl::rmq_succinct_sct<> &rmq )
+{
+	section_buffer buffer( ( const char * ) h + h->offset[s], h->bytes[s] );
+	std::istream is( &buffer );
+	rmq.load( is );
+}
+
+}  // namespace index_file
+
+#endif  // __INDEX_FILE_H_INCLUDED
@@ -0,0 +1,107 @@
+#ifndef __MIN_QUEUE_H_INCLUDED
+#define __MIN_QUEUE_H_INCLUDED
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "utils.h"
+
+/* Monotone queue of (fingerprint, position) pairs for sliding-window minima, in a ring buffer of fixed capacity whose front run holds the tied minima */
+class min_queue
+{
+	struct entry
+	{
+		uint64_t fp;
+		INT pos;
+	};
+
+	entry * buf;
+	uint64_t mask;
+	uint64_t head;
+	uint64_t tail;
+	INT ties;
+
+public:
+	/* capacity is the largest number of positions that can be in a window at once, i.e. ell-k+1 */
+	min_queue( INT capacity )
+	{
+		uint64_t cap = 1;
+		while( cap < ( uint64_t ) capacity )
+			cap <<= 1;
+
+		buf = ( entry * ) malloc( cap * sizeof( entry ) );
+		mask = cap - 1;
+		clear();
+	}
+
+	~min_queue()
+	{
+		free( buf );
+	}
+
+	min_queue( const min_queue & ) = delete;
+	min_queue & operator=( const min_queue & ) = delete;
+
+	void clear()
+	{
+		head = tail = 0;
+		ties = 0;
+	}
+
+	bool empty() const
+	{
+		return head == tail;
+	}
+
+	/* Appends a position; every entry with a larger fingerprint can no longer be a minimum and is dropped from the back */
+	void push( uint64_t fp, INT pos )
+	{
+		while( tail != head && buf[( tail - 1 ) & mask].fp > fp )
+			tail--;
+
+		if( tail == head )
+			ties = 1;
+		else if( buf[head & mask].fp == fp )
+			ties++;
+
+		buf[tail & mask].fp = fp;
+		buf[tail & mask].pos = pos;
+		tail++;
+	}
+
+	/* Drops the positions smaller than pos from the front; the tie run is recounted only when it runs out, so each entry is counted at most once */
+	void pop_before( INT pos )
+	{
+		while( head != tail && buf[head & mask].pos < pos )
+		{
+			head++;
+			if( --ties == 0 && head != tail )
+			{
+				uint64_t fp = buf[head & mask].fp;
+				ties = 1;
+				while( head + ties != tail && buf[( head + ties ) & mask].fp == fp )
+					ties++;
+			}
+		}
+	}
+
+	/* The smallest fingerprint in the window */
+	uint64_t min_fp() const
+	{
+		return buf[head & mask].fp;
+	}
+
+	/* The number of positions holding the smallest fingerprint */
+	INT tie_count() const
+	{
+		return ties;
+	}
+
+	/* The i-th position holding the smallest fingerprint, for i < tie_count() */
+	INT tie_pos( INT i ) const
+	{
+		return buf[( head + i ) & mask].pos;
+	}
+};
+
+#endif  // __MIN_QUEUE_H_INCLUDED
@@ -0,0 +1,110 @@
+#ifndef __ROLLING_HASH_H_INCLUDED
+#define __ROLLING_HASH_H_INCLUDED
+
+#include <cstdint>
+
+namespace karp_rabin_hashing {
+
+/* Karp-Rabin hashing modulo the Mersenne prime 2^61-1 for a fixed base and window length, with the powers of the base computed once, giving the results of krfp.cc; it is header-only so that the loops of ssa.cc and chunk_hashes.h can inline it */
+class rolling_hash
+{
+public:
+	static constexpr uint64_t exponent = 61;
+	static constexpr uint64_t prime = ( ( uint64_t ) 1 << exponent ) - 1;
+
+	/* (a * b) mod p, for a, b <= p */
+	static constexpr uint64_t mul( uint64_t a, uint64_t b )
+	{
+		__extension__ unsigned __int128 ab = ( unsigned __int128 ) a * ( unsigned __int128 ) b;
+		uint64_t lo = ( uint64_t ) ab;
+		uint64_t hi = ( uint64_t ) ( ab >> 64 );
+		lo = ( lo & prime ) + ( ( lo >> exponent ) + ( hi << ( 64 - exponent ) ) );
+		lo = ( lo & prime ) + ( lo >> exponent );
+		return lo == prime ? 0 : lo;
+	}
+
+	/* a mod p, for any a */
+	static constexpr uint64_t mod( uint64_t a )
+	{
+		a = ( a & prime ) + ( a >> exponent );
+		a = ( a & prime ) + ( a >> exponent );
+		return a == prime ? 0 : a;
+	}
+
+private:
+	uint64_t base;
+	uint64_t window;
+	uint64_t window_power;
+	uint64_t squares[64];
+
+public:
+	rolling_hash( uint64_t base, uint64_t window ) : base( base ), window( window )
+	{
+		squares[0] = mod( base );
+		for( int i = 1; i < 64; i++ )
+			squares[i] = mul( squares[i-1], squares[i-1] );
+
+		window_power = pow( window );
+	}
+
+	uint64_t get_base() const
+	{
+		return base;
+	}
+
+	uint64_t get_window() const
+	{
+		return window;
+	}
+
+	/* base^window mod p */
+	uint64_t power() const
+	{
+		return window_power;
+	}
+
+	/* base^e mod p */
+	uint64_t pow( uint64_t e ) const
+	{
+		uint64_t ret = 1;
+		for( int i = 0; e != 0; i++, e >>= 1 )
+			if( e & 1 )
+				ret = mul( ret, squares[i] );
+		return ret;
+	}
+
+	/* Hash of the string hashed by fp followed by the symbol c */
+	uint64_t append( uint64_t fp, unsigned char c ) const
+	{
+		return mod( mul( fp, base ) + c );
+	}
+
+	/* Hash of the concatenation of two strings, the second of length right_len */
+	uint64_t concat( uint64_t left, uint64_t right, uint64_t right_len ) const
+	{
+		return mod( mul( left, pow( right_len ) ) + right );
+	}
+
+	/* Hash of the last window symbols of a string, given the hash of the string and that of the prefix before them */
+	uint64_t subtract( uint64_t long_hash, uint64_t short_hash ) const
+	{
+		return subtract_power( long_hash, short_hash, window_power );
+	}
+
+	/* As above, for the last right_len symbols */
+	uint64_t subtract( uint64_t long_hash, uint64_t short_hash, uint64_t right_len ) const
+	{
+		return subtract_power( long_hash, short_hash, pow( right_len ) );
+	}
+
+private:
+	static uint64_t subtract_power( uint64_t long_hash, uint64_t short_hash, uint64_t power )
+	{
+		uint64_t tmp = mul( short_hash, power );
+		return ( long_hash >= tmp ) ? ( long_hash - tmp ) : ( ( long_hash + prime ) - tmp );
+	}
+};
+
+}  // namespace karp_rabin_hashing
+
+#endif  // __ROLLING_HASH_H_INCLUDED
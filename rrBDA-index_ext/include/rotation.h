@@ -0,0 +1,206 @@
+#ifndef __ROTATION_H_INCLUDED
+#define __ROTATION_H_INCLUDED
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utils.h"
+
+namespace rotation {
+
+/* Returns the length of the longest common prefix of x[0..len) and y[0..len), comparing 16 bytes at a time with SSE2 */
+inline INT mismatch( const unsigned char * x, const unsigned char * y, INT len )
+{
+	INT i = 0;
+
+#ifdef __SSE2__
+	for( ; i + 16 <= len; i += 16 )
+	{
+		__m128i vx = _mm_loadu_si128( ( const __m128i * ) ( x + i ) );
+		__m128i vy = _mm_loadu_si128( ( const __m128i * ) ( y + i ) );
+		unsigned int neq = ~_mm_movemask_epi8( _mm_cmpeq_epi8( vx, vy ) ) & 0xFFFF;
+		if( neq != 0 )
+			return i + __builtin_ctz( neq );
+	}
+#endif
+
+	for( ; i + 8 <= len; i += 8 )
+	{
+		uint64_t wx, wy;
+		memcpy( &wx, x + i, 8 );
+		memcpy( &wy, y + i, 8 );
+		uint64_t diff = wx ^ wy;
+		if( diff != 0 )
+		{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			return i + ( __builtin_ctzll( diff ) >> 3 );
+#else
+			return i + ( __builtin_clzll( diff ) >> 3 );
+#endif
+		}
+	}
+
+	for( ; i < len; i++ )
+		if( x[i] != y[i] )
+			return i;
+
+	return len;
+}
+
+/* Compares the rotations of X[0..w) starting at offsets a and b, returning a negative value, zero, or a positive value as in memcmp */
+inline int compare( const unsigned char * X, INT w, INT a, INT b )
+{
+	INT remaining = w;
+
+	while( remaining > 0 )
+	{
+		INT len = std::min( remaining, std::min( w - a, w - b ) );
+		INT l = mismatch( &X[a], &X[b], len );
+		if( l < len )
+			return ( int ) X[a+l] - ( int ) X[b+l];
+
+		remaining -= len;
+		a += len;
+		b += len;
+		if( a == w )
+			a = 0;
+		if( b == w )
+			b = 0;
+	}
+
+	return 0;
+}
+
+/* Answers LCE(i, i+s) queries on a fixed text for shifts s in [1,max_shift), remembering per shift the last run of matches so that queries moving forward scan the text only once */
+class shift_lce
+{
+	struct run
+	{
+		INT from;
+		INT to;
+		bool mismatch;
+	};
+
+	const unsigned char * T;
+	run * runs;
+	INT max_shift;
+
+	/* mismatch() of T[i..i+len) and T[i+s..i+s+len), counting the symbol pairs it compares */
+	INT scan( INT i, INT s, INT len )
+	{
+		INT l = mismatch( &T[i], &T[i+s], len );
+		compared += ( l < len ) ? l + 1 : len;
+		return l;
+	}
+
+public:
+	/* Symbol pairs compared by the queries so far; answers found in a run compare none */
+	uint64_t compared;
+
+	shift_lce( INT max_shift ) : T( NULL ), max_shift( max_shift ), compared( 0 )
+	{
+		runs = ( run * ) malloc( max_shift * sizeof( run ) );
+	}
+
+	~shift_lce()
+	{
+		free( runs );
+	}
+
+	shift_lce( const shift_lce & ) = delete;
+	shift_lce & operator=( const shift_lce & ) = delete;
+
+	/* Forgets all runs; must be called whenever the text changes */
+	void reset( const unsigned char * text )
+	{
+		T = text;
+		for( INT s = 0; s < max_shift; s++ )
+		{
+			runs[s].from = 1;
+			runs[s].to = 0;
+			runs[s].mismatch = false;
+		}
+	}
+
+	/* Returns min( limit, LCE(i, i+s) ); reads at most T[i..i+s+limit) */
+	INT lce( INT i, INT s, INT limit )
+	{
+		run &r = runs[s];
+
+		if( r.from <= i && i <= r.to )
+		{
+			if( r.to - i >= limit )
+				return limit;
+			if( r.mismatch )
+				return r.to - i;
+
+			INT end = i + limit;
+			r.to += scan( r.to, s, end - r.to );
+			r.mismatch = r.to < end;
+			return r.to - i;
+		}
+
+		INT l = scan( i, s, limit );
+		r.from = i;
+		r.to = i + l;
+		r.mismatch = l < limit;
+		return l;
+	}
+};
+
+/* Breaks ties between k-mers of a sliding window of length w of a text with LCE queries that carry over from one window to the next */
+class tie_breaker
+{
+	shift_lce kmer_lce;
+	shift_lce window_lce;
+
+public:
+	tie_breaker( INT w ) : kmer_lce( w ), window_lce( w )
+	{
+	}
+
+	void reset( const unsigned char * text )
+	{
+		kmer_lce.reset( text );
+		window_lce.reset( text );
+	}
+
+	/* Symbol pairs compared to break ties so far */
+	uint64_t compared() const
+	{
+		return kmer_lce.compared + window_lce.compared;
+	}
+
+	/* Returns true if the rotation of T[j..j+w) starting at b+k is not larger than the one starting at a+k, for a < b <= j+w-k */
+	bool later_wins( const unsigned char * T, INT j, INT w, INT k, INT a, INT b )
+	{
+		INT d = b - a;
+		INT pa = a + k;
+		INT pb = b + k;
+
+		INT len = j + w - pb;
+		INT l = kmer_lce.lce( pa, d, len );
+		if( l < len )
+			return T[pb+l] < T[pa+l];
+
+		l = window_lce.lce( j, w - d, d );
+		if( l < d )
+			return T[j+l] < T[j+w-d+l];
+
+		l = window_lce.lce( j, d, w - d );
+		if( l < w - d )
+			return T[j+d+l] < T[j+l];
+
+		return true;
+	}
+};
+
+}  // namespace rotation
+
+#endif  // __ROTATION_H_INCLUDED
@@ -0,0 +1,30 @@
+#ifndef __TEXT_VIEW_H_INCLUDED
+#define __TEXT_VIEW_H_INCLUDED
+
+#include "utils.h"
+
+/* Read-only view of a text T of length n, or of its reversal: the i-th symbol is T[i], or T[n-1-i] in the reversed view. Both directions of the index are built over the same buffer through their views, so the text is never reversed in place */
+class text_view
+{
+public:
+	text_view( const unsigned char * T, INT text_size, bool reversed ) : first( reversed ? T + text_size - 1 : T ), step( reversed ? -1 : 1 )
+	{
+	}
+
+	unsigned char operator[]( INT i ) const
+	{
+		return first[ i * step ];
+	}
+
+	/* The address of the i-th symbol, for prefetching */
+	const unsigned char * address( INT i ) const
+	{
+		return first + i * step;
+	}
+
+private:
+	const unsigned char * first;
+	INT step;
+};
+
+#endif  // __TEXT_VIEW_H_INCLUDED
@@ -23,21 +23,16 @@ namespace utils {
 
 long double wclock();
 
-struct FP_
- {
-   uint64_t               start_pos;
-   uint64_t               fp_pos;
-   uint64_t      	  pot_bd;
-   
- };
- 
-
 std::string absolute_path(std::string fname);
 std::FILE *file_open(std::string fname, std::string mode);
 void file_copy(std::string src_fname, std::string dest_fname);
 void file_delete(std::string fname);
 long file_size(std::string fname);
 bool file_exists(std::string fname);
+unsigned char *file_map(std::string fname, long size);
+void file_unmap(unsigned char *data, long size);
+unsigned char *file_map_shared(std::string fname, long &size);
+void file_unmap_shared(const unsigned char *data, long size);
 void find_stxxl_config();
 
 template<typename T>
@@ -74,6 +69,12 @@ void read_objects_at_offset(std::string filename, long offset, long count,
   std::fclose(f);
 }
 
+template<typename T>
+void write_objects_at_offset(std::FILE *f, long offset, long count, T *tab) {
+  std::fseek(f, sizeof(T) * offset, SEEK_SET);
+  add_objects_to_file<T>(f, count, tab);
+}
+
 template<typename T>
 T read_object_at_offset(std::FILE *f, long offset) {
   T ret;
@@ -35,25 +35,26 @@ using namespace sdsl;
 #include <divsufsort.h>                                       	  // include header for suffix sort
 #endif
 
-void reverse( unsigned char * &s, INT text_size)
+/* Writes the reversed text to file_name, read through its reversed view, so that the text itself is never reversed */
+void write_reversed( unsigned char * text_string, INT text_size, const char * file_name )
 {
-	INT length = text_size ;
+	text_view reversed( text_string, text_size, true );
+	vector<unsigned char> buffer( std::min( text_size, ( INT ) 1 << 20 ) );
 	
-	unsigned char temp = ' ';
-	INT i = 0, j = length-1;
-	
-	while( i < j )
+	std::ofstream output_r;
+	output_r.open( file_name );
+	for( INT i = 0; i < text_size; i += buffer.size() )
 	{
-		temp = s[j];
-		s[j] = s[i];
-		s[i] = temp;
-		
-		i++, j--;
+		INT length = std::min( ( INT ) buffer.size(), text_size - i );
+		for( INT j = 0; j < length; j++ )
+			buffer[j] = reversed[ i + j ];
+		output_r.write( (char*) buffer.data(), length );
 	}
+	output_r.close();
 }
  
 /* Constructs the right compacted trie given the anchors and the SA of the whole string in O(n) time */
-void right_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * RSA, INT * RLCP, INT g, INT ram_use, string sa_fname, string lcp_fname )
+void right_compacted_trie ( bit_vector &anchors, INT n, INT * RSA, INT * RLCP, INT g, INT ram_use, string sa_fname, string lcp_fname )
 {
 	stream_reader<uint40>* SA =  new stream_reader <uint40> (sa_fname, ram_use);
 	stream_reader<uint40>* LCP =  new stream_reader <uint40> (lcp_fname, ram_use);
@@ -64,7 +65,7 @@ void right_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * RSA, INT *
 	INT currSA = 0;
 	INT currLCP = 0;
 
-	for( INT i = 0; i <= n; i++ ) // in lex order
+	for( INT i = 0; i < n; i++ ) // in lex order; the arrays have n entries
 	{
 		
 		/* If the ith lex suffix is an anchor then add it to the compacted trie (encoded in arrays RSA and RLCP) */
@@ -72,8 +73,7 @@ void right_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * RSA, INT *
 		currSA = SA->read();
 		currLCP = LCP->read();
 		
-		auto it = anchors.find( currSA );
-		if( it != anchors.end() )
+		if( currSA < n && anchors[currSA] )
 		{
 			
 			RSA[ii] = currSA;		// store this suffix
@@ -104,7 +104,7 @@ void right_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * RSA, INT *
 }
 
 /* Constructs the left compacted trie given the anchors and the SA of the whole string in O(n) time */
-void left_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * LSA, INT * LLCP, INT g, INT ram_use, string sa_fname, string lcp_fname )
+void left_compacted_trie ( bit_vector &anchors, INT n, INT * LSA, INT * LLCP, INT g, INT ram_use, string sa_fname, string lcp_fname )
 {
 
 	stream_reader<uint40>* SA =  new stream_reader <uint40> (sa_fname, ram_use);
@@ -117,15 +117,14 @@ void left_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * LSA, INT *
 	INT currSA = 0;
 	INT currLCP = 0;
 
-	for( INT i = 0; i <= n; i++ ) // in lex order
+	for( INT i = 0; i < n; i++ ) // in lex order; the arrays have n entries
 	{
 		/* If the ith lex suffix is an anchor then add it to the compacted trie (encoded in arrays RSA and RLCP) */
 		prevSA = currSA;
 		currSA = SA->read();
 		currLCP = LCP->read();
-		auto it = anchors.find( ( n - 1 ) - currSA );
 		//cout<<currSA<<" "<<currLCP<<endl;
-		if( it != anchors.end() )
+		if( currSA < n && anchors[( n - 1 ) - currSA] )
 		{
 			
 			LSA[ii] = currSA;		// store this suffix
@@ -156,9 +155,42 @@ void left_compacted_trie ( unordered_set<INT> &anchors, INT n, INT * LSA, INT *
 }
 
 
-INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsigned char * text_string, unordered_set<INT> &text_anchors, INT * RSA, INT * RLCP, INT * LSA, INT * LLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, char * arg0, char * arg1, INT ram_use )
+/* Whether an array is in a text file of earlier versions that can be loaded */
+bool legacy_file( string file_name )
+{
+	return utils::file_exists( file_name ) && utils::file_size( file_name ) > 0;
+}
+
+/* The number of bd-anchors of an index in the text files of earlier versions, one per line of its .RSA file, or 0 unless its four arrays are all there */
+INT legacy_anchors( string index_name )
+{
+	if( !legacy_file( index_name + ".RSA" ) || !legacy_file( index_name + ".RLCP" ) || !legacy_file( index_name + ".LSA" ) || !legacy_file( index_name + ".LLCP" ) )
+		return 0;
+	ifstream is_RSA( index_name + ".RSA", ios::binary );
+	return std::count( istreambuf_iterator<char>( is_RSA ), istreambuf_iterator<char>(), '\n' );
+}
+
+/* Builds the compacted tries of the bd-anchors of index_name, or loads them from the text files of earlier versions if they exist. The suffix and LCP arrays of the whole text and of its reverse are stored under sa_name, so that indexes over different anchors of the same text share them */
+INT compute_index( uint64_t hash, string index_name, string sa_name, INT text_size, INT g, unsigned char * text_string, vector<INT> &text_anchors, INT * RSA, INT * RLCP, INT * LSA, INT * LLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, char * arg0, char * arg1, INT ram_use, build_strategy::kind strategy )
 {
 	/* Constructing right and left compacted tries */
+	
+	/* The strategy is chosen for both directions unless the tries are loaded from the text files of earlier versions */
+	bool legacy = legacy_anchors( index_name ) > 0;
+	if( !legacy )
+	{
+		bool external_ready = utils::file_exists( sa_name + "_SA.sa5" ) && utils::file_exists( sa_name + "_LCP.lcp5" ) && utils::file_exists( sa_name + "_reverse_SA.sa5" ) && utils::file_exists( sa_name + "_reverse_LCP.lcp5" );
+		build_strategy::input in = { text_size, g, 1, std::min( build_strategy::available_memory(), ram_use * 1024.0 * 1024.0 ), 0, 0, 0, ram_use * 1024.0 * 1024.0, false, true, external_ready };
+		cout<<"Estimates for building the compacted tries, with "<<in.memory / ( 1024.0 * 1024.0 )<<" MB available:"<<endl;
+		strategy = build_strategy::choose( in, strategy );
+		cout<<"The compacted tries are built by the "<<build_strategy::name( strategy )<<" strategy"<<endl;
+	}
+	
+	/* Membership of the suffixes read from the SA streams is tested against a bitvector over the text positions; the anchors of loaded tries are not computed */
+	bit_vector anchors_bv( text_size, 0 );
+	for(INT i = 0; i<(INT) text_anchors.size(); i++)
+		anchors_bv[ text_anchors[i] ] = 1;
+	vector<INT>().swap( text_anchors );
 
 	string rsa = index_name + ".RSA";
 	unsigned char c = 0;
@@ -168,12 +200,12 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
  	
 	ifstream in_RSA(rsa, ios::binary);
 
-   	string sa_fname = index_name + "_SA.sa5";
+   	string sa_fname = sa_name + "_SA.sa5";
 	ifstream in_SA(sa_fname, ios::binary);
 	in_RSA.seekg (0, in_RSA.end);
 	INT file_size_sa = in_RSA.tellg();
 	
-	if( !(in_SA)  )
+	if( !legacy && !(in_SA) && strategy == build_strategy::EXTERNAL )
 	{
 
 	  	char commandesa[ sa_fname.length() + 1000 ];
@@ -222,12 +254,14 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 	INT file_size = in_RLCP.tellg();
 	
    	
-   	string lcp_fname = index_name + "_LCP.lcp5";
+   	string lcp_fname = sa_name + "_LCP.lcp5";
 	ifstream in_LCP(lcp_fname, ios::binary);
 	
-	if ( !(in_LCP) || file_size <= 0 || file_size_sa <= 0 )
+	if ( !legacy && ( file_size <= 0 || file_size_sa <= 0 || ( !(in_LCP) && strategy == build_strategy::EXTERNAL ) ) )
 	{
-		if( !(in_LCP ) )
+		if( strategy == build_strategy::FULL )
+			full_sa::compacted_trie( text_string, text_size, anchors_bv, false, RSA, RLCP );
+		else if( !(in_LCP ) )
 		{
 			char commande[ sa_fname.length() + lcp_fname.length() + 1000];
 			char * fullpathstart = dirname(realpath(arg0, NULL));
@@ -239,23 +273,8 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 		}
 		
 	    	
-	  	right_compacted_trie ( text_anchors, text_size, RSA, RLCP, g, ram_use, sa_fname, lcp_fname );
-	  	
-	  	ofstream rsa_output;
-		rsa_output.open(rsa);
-		
-		for(INT i = 0; i<g; i++)	
-			rsa_output<<RSA[i]<<endl;
-			
-		rsa_output.close();
-		
-		ofstream rlcp_output;
-		rlcp_output.open(rlcp);
-		
-		for(INT i = 0; i<g; i++)	
-			rlcp_output<<RLCP[i]<<endl;
-			
-		rlcp_output.close();
+		if( strategy == build_strategy::EXTERNAL )
+	  		right_compacted_trie ( anchors_bv, text_size, RSA, RLCP, g, ram_use, sa_fname, lcp_fname );
 		
 		cout<<"Right Compacted trie constructed "<<endl;	
 	}
@@ -293,13 +312,9 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 	strcpy( output_reverse, arg1);
 	strcat(output_reverse, reversed_text);
 		
-  	/* We reverse the string for the left direction and also overwrite all other DSs */
-  	std::ofstream output_r;
-  	output_r.open (output_reverse);
-  	
-  	reverse(text_string, text_size);
-  	output_r << text_string;
-    	output_r.close();
+  	/* The SA and LCP array of the left direction are those of the reversed text, which the external tools read from a file */
+  	if( !legacy && strategy == build_strategy::EXTERNAL )
+  		write_reversed( text_string, text_size, output_reverse );
  
 	string lsa = index_name + ".LSA";
   	
@@ -312,10 +327,10 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
   	in_LSA.seekg (0, in_LSA.end);
   	file_size_sa = in_LSA.tellg();
   	
-   	string sa_fname_reverse = index_name +"_reverse_SA.sa5";
+   	string sa_fname_reverse = sa_name + "_reverse_SA.sa5";
 	ifstream in_SA_reverse(sa_fname_reverse, ios::binary);
 	
-	if ( !(in_SA_reverse)  )
+	if ( !legacy && !(in_SA_reverse) && strategy == build_strategy::EXTERNAL )
 	{
 	  	char commandesa_reverse[ sa_fname_reverse.length() + 1000 ];
 	  	char * fullpathstart_reverse = dirname(realpath(arg0, NULL));
@@ -359,14 +374,22 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 	in_LLCP.seekg (0, in_LLCP.end);
 	file_size = in_LLCP.tellg();
    	
- 	string lcp_fname_reverse = index_name + "_reverse_LCP.lcp5";
+ 	string lcp_fname_reverse = sa_name + "_reverse_LCP.lcp5";
         ifstream in_LCP_reverse(lcp_fname_reverse, ios::binary);
 	
 	
-        if( !(in_LCP_reverse) || file_size <= 0 || file_size_sa <= 0 )
+        if( !legacy && ( file_size <= 0 || file_size_sa <= 0 || ( !(in_LCP_reverse) && strategy == build_strategy::EXTERNAL ) ) )
 	{
-	
-		if( !(in_LCP_reverse ) )
+		/* libdivsufsort sorts a text in one piece, so the reversed text is copied out of its view */
+		if( strategy == build_strategy::FULL )
+		{
+			text_view reversed( text_string, text_size, true );
+			vector<unsigned char> reversed_text( text_size );
+			for(INT i = 0; i<text_size; i++)
+				reversed_text[i] = reversed[i];
+			full_sa::compacted_trie( reversed_text.data(), text_size, anchors_bv, true, LSA, LLCP );
+		}
+		else if( !(in_LCP_reverse ) )
 		{
 			char commande_reverse[ sa_fname_reverse.length() + lcp_fname_reverse.length() + 1000];
 			char * fullpathstart_reverse = dirname(realpath(arg0, NULL));
@@ -377,23 +400,8 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 			int out_reverse=system(commande_reverse);
 		}
 		
-		left_compacted_trie ( text_anchors, text_size, LSA, LLCP, g, ram_use, sa_fname_reverse, lcp_fname_reverse );
-  		
-  		ofstream lsa_output;
-		lsa_output.open(lsa);
-		
-		for(INT i = 0; i<g; i++)	
-			lsa_output<<LSA[i]<<endl;
-			
-		lsa_output.close();
-		
-		ofstream llcp_output;
-		llcp_output.open(llcp);
-		
-		for(INT i = 0; i<g; i++)	
-			llcp_output<<LLCP[i]<<endl;
-			
-		llcp_output.close();
+		if( strategy == build_strategy::EXTERNAL )
+			left_compacted_trie ( anchors_bv, text_size, LSA, LLCP, g, ram_use, sa_fname_reverse, lcp_fname_reverse );
 	
 		cout<<"Left Compacted trie constructed"<<endl;
 	}
@@ -424,7 +432,7 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 		is_LLCP.close();
 	}
 	/* After constructing the tries these DSs over the whole string are not needed anymore, our data structure must be of size O(g) */
-  	text_anchors.clear();
+  	util::clear( anchors_bv );
   	
   	/* The following RMQ data structures are used for spelling pattern over the LSA and RSA */
   
@@ -451,8 +459,6 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 		util::assign(lrmq, rmq_succinct_sct<>(&llcp_rmq));
 		
 		util::clear(llcp_rmq);
-
-		store_to_file(lrmq, rmq_left_suffix);
 	}
 	
 	cout<<"Left RMQ DS constructed "<<endl;
@@ -479,13 +485,10 @@ INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsig
 		
 		util::assign(rrmq, rmq_succinct_sct<>(&rlcp_rmq));
 		util::clear(rlcp_rmq);
-		 	  	
-	  	store_to_file(rrmq, rmq_right_suffix);
 	}	
 	 
 	cout<<"Right RMQ DS constructed "<<endl; 
   	cout<<"The whole index is constructed"<<endl;
-  	reverse(text_string, text_size); 
 	
 	return 0;
 }	
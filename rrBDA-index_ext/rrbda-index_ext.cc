@@ -16,6 +16,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
+#include "utils.h"
 #include "stream.h"
 #include "uint40.h"
 #include <math.h>
@@ -35,31 +36,43 @@
 
 int main(int argc, char **argv)
 {
-	unordered_set<unsigned char> alphabet;
-
 	if( argc < 8 )
  	{
         	cout<<"Wrong arguments!\n";
- 		cout<<"./rrbda-index_ext <text_file> <ell> <pattern_file> <block_size> <ram_use> <output_filename> <index_filename>\n";
+ 		cout<<"./rrbda-index_ext <text_file> <ell>[,<ell>...] <pattern_file> <block_size> <ram_use> <output_filename> <index_filename> [-t <threads>] [-m <symbols>] [-s <seeds>] [-S <sample_size>] [-j <report_file>] [-c <strategy>]\n";
  		exit(-1);
  	}
 	
 	// Input text file
- 	ifstream is_text;
  	char * arg1 = argv[1];
  	char * arg0 = argv[0];
  	
- 	is_text.open (arg1, ios::in | ios::binary);
- 	
  	ifstream in_file(arg1, ios::binary);
    	in_file.seekg(0, ios::end);
    	INT text_file_size = in_file.tellg();
 
-	// Input ell
+	// Input ell, or a ladder of ells separated by commas
  	std::string str_ell(argv[2]);
  	
- 	INT ell;
- 	std::stringstream(str_ell)>>ell;
+ 	vector<INT> ells;
+ 	std::stringstream ss_ell(str_ell);
+ 	for( string item; getline( ss_ell, item, ',' ); )
+ 	{
+ 		INT e = 0;
+ 		std::stringstream(item)>>e;
+ 		ells.push_back( e );
+ 	}
+ 	sort( ells.begin(), ells.end() );
+ 	ells.erase( unique( ells.begin(), ells.end() ), ells.end() );
+ 	
+ 	if( ells.empty() || ells.front() < 1 )
+ 	{
+ 		fprintf( stderr, " Error: Window size (ell) must be positive!\n");
+ 		return ( 1 );
+ 	}
+ 	
+ 	/* The smallest order fixes k, which all orders share so that the fingerprints of the k-mers are computed once; an index stored for the first order keeps the k it was built with */
+ 	INT ell = ells.front();
 	
 	// Input block size
  	std::string str_block(argv[4]);
@@ -82,123 +95,328 @@ int main(int argc, char **argv)
  	
  	// Input index file
  	string index_name = argv[7];
-    	ifstream is_index;
- 	is_index.open (argv[7], ios::in | ios::binary);
 
- 	unordered_set<INT> text_anchors;
-   	
-   	unsigned char c = 0;
-  	INT text_size = 0;
-	for (INT i = 0; i < text_file_size; i++)
-	{	
-		is_text.read(reinterpret_cast<char*>(&c), 1);
-		
-		alphabet.insert( (unsigned char) c );
-		text_size++;
-	}
-	is_text.close();
+ 	// Optional arguments
+ 	INT threads = 1;
+ 	string mask_symbols;
+ 	INT seeds = 1;
+ 	INT sample = 0;
+ 	string report_name;
+ 	string strategy_name = "auto";
+ 	for( INT i = 8; i < argc; i++ )
+ 	{
+ 		string opt = argv[i];
+ 		if( opt == "-t" && i + 1 < argc )
+ 			std::stringstream(argv[++i])>>threads;
+ 		else if( opt == "-m" && i + 1 < argc )
+ 			mask_symbols = argv[++i];
+ 		else if( opt == "-s" && i + 1 < argc )
+ 			std::stringstream(argv[++i])>>seeds;
+ 		else if( opt == "-S" && i + 1 < argc )
+ 			std::stringstream(argv[++i])>>sample;
+ 		else if( opt == "-j" && i + 1 < argc )
+ 			report_name = argv[++i];
+ 		else if( opt == "-c" && i + 1 < argc )
+ 			strategy_name = argv[++i];
+ 		else
+ 		{
+ 			fprintf( stderr, " Error: Unknown option %s!\n", argv[i] );
+ 			return ( 1 );
+ 		}
+ 	}
+ 	
+ 	if( threads < 1 )
+ 		threads = 1;
+ 	
+ 	if( seeds < 1 )
+ 		seeds = 1;
+ 	
+ 	if( strategy_name != "auto" && strategy_name != "full" && strategy_name != "external" )
+ 	{
+ 		fprintf( stderr, " Error: Unknown strategy %s!\n", strategy_name.c_str() );
+ 		return ( 1 );
+ 	}
+
+  	INT text_size = text_file_size;
 	
-	if( text_size < ell )
+	if( text_size < ells.back() )
 	{
 	
 		fprintf( stderr, " Error: Window size (ell) cannot be larger than sequence length!\n");
 		return ( 1 );
 	}
 	
-	if( block < ell )
+	if( block < ells.back() )
 	{
 		fprintf( stderr, " Error: Window size (ell) cannot be larger than the block size!\n");
 		return ( 1 );
 	}
 	
-	INT k  = ceil(4*log2(ell)/log2(alphabet.size()));
+	/* Every order has its own index; a single order keeps the plain index name */
+	INT num_levels = ells.size();
+	vector<index_level> levels( num_levels );
+	for( INT l = 0; l < num_levels; l++ )
+	{
+		levels[l].ell = ells[l];
+		levels[l].index_name = ( num_levels == 1 ) ? index_name : index_name + ".ell" + to_string( ells[l] );
+	}
+	
+	/* An index whose files all exist is queried with the parameters and alphabet stored in them, without computing the bd-anchors again */
+	bool index_loaded = true;
+	for( INT l = 0; l < num_levels; l++ )
+		index_loaded = index_loaded && utils::file_exists( levels[l].index_name );
+	
+	/* A level only in the text files of earlier versions is loaded from them and rewritten as an index file, so its bd-anchors are needed only if another level is built */
+	bool anchors_needed = false;
+	for( INT l = 0; l < num_levels; l++ )
+	{
+		bool stored = utils::file_exists( levels[l].index_name );
+		levels[l].legacy = !stored && utils::file_exists( levels[l].index_name + ".RSA" );
+		if( !levels[l].legacy )
+		{
+			anchors_needed = anchors_needed || !stored;
+			continue;
+		}
+		levels[l].g = legacy_anchors( levels[l].index_name );
+		if( levels[l].g == 0 )
+		{
+			fprintf( stderr, " Error: The index of an earlier version in %s.RSA is incomplete: its .RLCP, .LSA or .LLCP file is missing!\n", levels[l].index_name.c_str() );
+			return ( 1 );
+		}
+	}
+	
+	/* The text is mapped into memory once; the alphabet histogram is the only full pass over it before the bd-anchors are computed */
+	unsigned char * text_string = utils::file_map( arg1, text_size );
+	
+	INT alphabet_hist[256] = {0};
+	if( !index_loaded )
+	{
+		#pragma omp parallel for reduction(+:alphabet_hist[:256]) num_threads( threads )
+		for (INT i = 0; i < text_size; i++)
+			alphabet_hist[text_string[i]]++;
+	}
+	
+	/* Masked symbols are separators: they take no part in the alphabet and no window containing one gets an anchor */
+	bool masked[256] = {false};
+	for (INT i = 0; i < (INT) mask_symbols.size(); i++)
+		masked[(unsigned char) mask_symbols[i]] = true;
+	
+	/* An index keeps the ranking policy and the Karp-Rabin base it was built with, in its index file or else in the policy file of earlier versions, which defaults to Karp-Rabin fingerprints with the default base */
+	string policy_name = index_name + ".hash";
+	bool index_file_exists = utils::file_exists( levels[0].index_name );
+	bool index_exists = index_file_exists || utils::file_exists( levels[0].index_name + ".RSA" );
+	string kind = "kr";
+	uint64_t hash = karp_rabin_hashing::init();
+	INT stored_k = 0;
+	if( index_file_exists )
+	{
+		uint64_t file_size;
+		const index_file::header * file = index_file::map( levels[0].index_name, file_size );
+		if( file == NULL )
+		{
+			fprintf( stderr, " Error: %s is not an index file of this version!\n", levels[0].index_name.c_str() );
+			return ( 1 );
+		}
+		kind = ( file->policy == anchor_hash::PACKED ) ? "packed" : "kr";
+		hash = karp_rabin_hashing::init( file->base );
+		stored_k = file->k;
+		if( index_loaded )
+			index_file::load_alphabet( file, alphabet_hist );
+		index_file::unmap( file, file_size );
+	}
+	else if( index_exists )
+	{
+		ifstream is_policy( policy_name );
+		uint64_t stored_hash;
+		if( is_policy )
+			is_policy >> kind;
+		if( is_policy >> stored_hash )
+			hash = karp_rabin_hashing::init( stored_hash );
+	}
+	
+	INT sigma = 0;
+	INT masked_count = 0;
+	for (INT c = 0; c < 256; c++)
+	{
+		if( masked[c] )
+			masked_count += alphabet_hist[c];
+		else if( alphabet_hist[c] > 0 )
+			sigma++;
+	}
+	
+	INT k  = ceil(4*log2(ell)/log2(sigma));
 	if( ell - k - 1 < 0 )
 		k = 2;
+	if( index_file_exists )
+		k = stored_k;
 	
-	uint64_t hash = karp_rabin_hashing::init();
-	uint64_t power = karp_rabin_hashing::pow_mod_mersenne(hash, k, 61);
+	if( !index_exists && seeds > 1 )
+	{
+		/* Each bd-anchor costs an entry in both suffix arrays and LCP arrays, so the base giving the fewest anchors on a sample is kept */
+		std::chrono::steady_clock::time_point  start_seed = std::chrono::steady_clock::now();
+		vector<INT> counts;
+		hash = search_base( text_string, text_size, block, ells, k, alphabet_hist, threads, mask_symbols.empty() ? NULL : masked, seeds, sample, counts );
+		std::chrono::steady_clock::time_point  end_seed = std::chrono::steady_clock::now();
+		std::cout <<"Seed search took " << std::chrono::duration_cast<std::chrono::milliseconds>(end_seed - start_seed).count() << " [ms]" << std::endl;
+		cout<<"The best of "<<seeds<<" seeds gives "<<*min_element( counts.begin(), counts.end() )<<" bd-anchors on the sample (the first gives "<<counts[0]<<")"<<endl;
+	}
+	
+	/* The k-mers are ranked by the packed policy if they fit in a word; an existing index fixes the policy it was built with */
+	anchor_hash::policy hash_policy( k, hash, alphabet_hist, mask_symbols.empty() ? NULL : masked );
+	if( index_exists )
+		hash_policy.set_kind( kind == "packed" ? anchor_hash::PACKED : anchor_hash::KR );
 
 	/* Compute bd-anchors */
 	std::chrono::steady_clock::time_point  start_bd = std::chrono::steady_clock::now();
 
-    	compute_anchors(arg1, text_anchors, text_size, block, ell, k, power );
+	vector<vector<INT>> level_anchors;
+	anchor_report report;
+	if( anchors_needed )
+    		compute_anchors(text_string, level_anchors, text_size, block, ells, k, hash_policy, threads, mask_symbols.empty() ? NULL : masked, report_name.empty() ? NULL : &report, NULL );
     	
-    	INT g = text_anchors.size();
     	INT n = text_size;
     	
     	std::chrono::steady_clock::time_point  end_bd = std::chrono::steady_clock::now();
-	std::cout <<"bd construction took " << std::chrono::duration_cast<std::chrono::milliseconds>(end_bd - start_bd).count() << " [ms]" << std::endl;
-	cout<<"The text is of length "<< n << ", its alphabet size is "<< alphabet.size()<<", and it has "<<g<<" bd-anchors of order "<<ell<<endl;
-	cout<<"The density is "<<(double) g / n<<endl;
-    	
-	unsigned char * text_string = ( unsigned char * ) malloc (  ( text_size + 1 ) * sizeof ( unsigned char ) );
-	ifstream is_full;
- 	is_full.open (arg1, ios::in | ios::binary);
- 	
-	c = 0;
-	for (INT i = 0; i < text_size; i++)
-	{	
-		is_full.read(reinterpret_cast<char*>(&c), 1);
-		text_string[i] = (unsigned char) c;
+	if( !anchors_needed )
+		level_anchors.resize( num_levels );
+	else
+	{
+		std::cout <<"bd construction took " << std::chrono::duration_cast<std::chrono::milliseconds>(end_bd - start_bd).count() << " [ms]" << std::endl;
+		for( INT l = 0; l < num_levels; l++ )
+		{
+			if( !levels[l].legacy )
+				levels[l].g = level_anchors[l].size();
+			cout<<"The text is of length "<< n << ", its alphabet size is "<< sigma <<", and it has "<<levels[l].g<<" bd-anchors of order "<<levels[l].ell<<endl;
+			cout<<"The density is "<<(double) levels[l].g / n<<endl;
+		}
+		if( !mask_symbols.empty() )
+			cout<<masked_count<<" symbols of the text are masked"<<endl;
+		if( !report_name.empty() )
+		{
+			report.write_json( report_name );
+			cout<<"The anchor statistics are written to "<<report_name<<endl;
+		}
+		
+		for( INT l = 0; l < num_levels; l++ )
+		{
+			if( levels[l].g == 0 )
+			{
+				fprintf( stderr, " Error: No bd-anchors were found outside the masked regions!\n");
+				return ( 1 );
+			}
+		}
 	}
-	is_full.close();
-	
+	cout<<"The k-mers are ranked by the "<<hash_policy.name()<<" policy"<<endl;
+    	
 	std::chrono::steady_clock::time_point  start_index = std::chrono::steady_clock::now();
 	
-	INT * RSA;
-	INT * RLCP;
-
-	RSA = ( INT * ) malloc( ( g ) * sizeof( INT ) );
-	if( ( RSA == NULL) )
+	/* An index is checked against the text by the checksum of a sample of it, and a newly built one also by the checksum of the whole text */
+	uint64_t text_checksum = index_loaded ? 0 : index_file::checksum( text_string, text_size, threads );
+	uint64_t sample_checksum = index_file::sample_checksum( text_string, text_size );
+	uint64_t mask_checksum = index_file::checksum( ( unsigned char * ) masked, sizeof( masked ), 1 );
+	
+	for( INT l = 0; l < num_levels; l++ )
 	{
-	 	fprintf(stderr, " Error: Cannot allocate memory for RSA.\n" );
-		return ( 0 );
-	}
+		index_level &lv = levels[l];
+		INT g = lv.g;
+		bool built = !utils::file_exists( lv.index_name );
+		if( built )
+		{
+			INT * RSA = ( INT * ) malloc( ( g ) * sizeof( INT ) );
+			if( ( RSA == NULL) )
+			{
+			 	fprintf(stderr, " Error: Cannot allocate memory for RSA.\n" );
+				return ( 0 );
+			}
 
-	RLCP = ( INT * ) malloc( ( g+1 ) * sizeof( INT ) );
-	if( ( RLCP == NULL) )
-	{
-	 	fprintf(stderr, " Error: Cannot allocate memory for RLCP.\n" );
-		return ( 0 );
+			INT * RLCP = ( INT * ) malloc( ( g+1 ) * sizeof( INT ) );
+			if( ( RLCP == NULL) )
+			{
+			 	fprintf(stderr, " Error: Cannot allocate memory for RLCP.\n" );
+				return ( 0 );
+			}
+			
+		  	INT * LSA = ( INT * ) malloc( ( g ) * sizeof( INT ) );
+		  	if( ( LSA == NULL) )
+		  	{
+		  		fprintf(stderr, " Error: Cannot allocate memory for LSA.\n" );
+		        	return ( 0 );
+		  	}
+		  	INT * LLCP = ( INT * ) malloc( ( g+1 ) * sizeof( INT ) );
+		  	if( ( LLCP == NULL) )
+		  	{
+		  		fprintf(stderr, " Error: Cannot allocate memory for LLCP.\n" );
+		        	return ( 0 );
+		  	}
+		  	
+		  	/* The suffix and LCP arrays of the text are stored under the plain index name and shared by all orders */
+		  	compute_index( hash, lv.index_name, index_name, text_size, g, text_string, level_anchors[l], RSA, RLCP, LSA, LLCP, lv.lrmq, lv.rrmq, arg0, arg1, ram_use, build_strategy::parse( strategy_name ) );
+		  	
+			index_file::header h = {};
+			h.n = text_size;
+			h.g = g;
+			h.ell = lv.ell;
+			h.k = k;
+			h.base = hash;
+			h.policy = hash_policy.get_kind();
+			index_file::store_alphabet( h, alphabet_hist );
+			h.text_checksum = text_checksum;
+			h.sample_checksum = sample_checksum;
+			h.mask_checksum = mask_checksum;
+			const INT * arrays[4] = { RSA, RLCP, LSA, LLCP };
+			index_file::write( lv.index_name, h, arrays, lv.rrmq, lv.lrmq );
+			if( lv.legacy )
+				cout<<"The index of order "<<lv.ell<<" with "<<g<<" bd-anchors is loaded from the text files of "<<lv.index_name<<endl;
+			cout<<"The index is written to "<<lv.index_name<<endl;
+			
+			free ( RSA );
+			free ( RLCP );
+			free ( LSA );
+			free ( LLCP );
+		}
+		
+		/* The tries are read in place from the mapped index file */
+		lv.file = index_file::map( lv.index_name, lv.file_size );
+		if( lv.file == NULL )
+		{
+			fprintf( stderr, " Error: %s is not an index file of this version!\n", lv.index_name.c_str() );
+			return ( 1 );
+		}
+		if( lv.file->n != ( uint64_t ) text_size || lv.file->ell != ( uint64_t ) lv.ell || lv.file->k != ( uint64_t ) k || lv.file->sample_checksum != sample_checksum || lv.file->mask_checksum != mask_checksum || ( !index_loaded && ( lv.file->g != ( uint64_t ) g || lv.file->text_checksum != text_checksum ) ) )
+		{
+			fprintf( stderr, " Error: %s was built from another text or with other parameters!\n", lv.index_name.c_str() );
+			return ( 1 );
+		}
+		if( index_loaded )
+		{
+			lv.g = lv.file->g;
+			cout<<"The index of order "<<lv.ell<<" with "<<lv.g<<" bd-anchors is loaded from "<<lv.index_name<<endl;
+		}
+		lv.RSA = index_file::array( lv.file, index_file::RSA );
+		lv.RLCP = index_file::array( lv.file, index_file::RLCP );
+		lv.LSA = index_file::array( lv.file, index_file::LSA );
+		lv.LLCP = index_file::array( lv.file, index_file::LLCP );
+		if( !built )
+		{
+			index_file::load_rmq( lv.file, index_file::RRMQ, lv.rrmq );
+			index_file::load_rmq( lv.file, index_file::LRMQ, lv.lrmq );
+		}
 	}
-	
-	INT * LSA;
-  	INT * LLCP;
-
-  	LSA = ( INT * ) malloc( ( g ) * sizeof( INT ) );
-  	if( ( LSA == NULL) )
-  	{
-  		fprintf(stderr, " Error: Cannot allocate memory for LSA.\n" );
-        	return ( 0 );
-  	}
-  	LLCP = ( INT * ) malloc( ( g+1 ) * sizeof( INT ) );
-  	if( ( LLCP == NULL) )
-  	{
-  		fprintf(stderr, " Error: Cannot allocate memory for LLCP.\n" );
-        	return ( 0 );
-  	}
-  	 
-  	rmq_succinct_sct<> lrmq;
-  	rmq_succinct_sct<> rrmq;
-  	
-  	compute_index( hash, index_name, text_size, g, text_string, text_anchors, RSA, RLCP, LSA, LLCP, lrmq, rrmq, arg0, arg1, ram_use );
 	std::chrono::steady_clock::time_point  end_index = std::chrono::steady_clock::now();
 	std::cout <<"Index construction took " << std::chrono::duration_cast<std::chrono::milliseconds>(end_index- start_index + end_bd - start_bd).count() << " [ms]" << std::endl;
   
   	/* Query */
 	std::chrono::steady_clock::time_point  begin_pt = std::chrono::steady_clock::now();
 
-	INT hits = query(argv[3], text_string, output_filename, text_size, LSA, LLCP, RSA, RLCP, lrmq, rrmq, g, ell, power, k );
+	INT hits = query(argv[3], text_string, output_filename, text_size, levels, hash_policy, k );
 	
  	std::chrono::steady_clock::time_point  end_pt = std::chrono::steady_clock::now();
 	std::cout <<"Pattern matching took " << std::chrono::duration_cast<std::chrono::milliseconds>(end_pt - begin_pt).count() << " [ms]" << std::endl;
 	std::cout <<"Occurrences: "<< hits <<endl;
  
-	free ( RSA );
-  	free ( RLCP );
-  	free ( LSA );
-  	free ( LLCP );
-  	free( text_string );
+	for( INT l = 0; l < num_levels; l++ )
+		index_file::unmap( levels[l].file, levels[l].file_size );
+  	utils::file_unmap( text_string, text_size );
 	return 0;
   	
   	return 0;
@@ -23,6 +23,15 @@
 #include <sstream>
 #include <sdsl/bit_vectors.hpp>                                   
 #include <sdsl/rmq_support.hpp>
+#include "min_queue.h"
+#include "rotation.h"
+#include "anchor_hash.h"
+#include "anchor_report.h"
+#include "chunk_hashes.h"
+#include "text_view.h"
+#include "full_sa.h"
+#include "build_strategy.h"
+#include "index_file.h"
 
 #ifdef _USE_64
 typedef int64_t INT;
@@ -35,12 +44,32 @@ typedef int32_t INT;
 
 using namespace sdsl;
 using namespace std;
+
+/* One level of the index: the bd-anchors of order ell and the compacted tries built over them, kept in the index file index_name and read in place from its mapping; legacy tells that they are first loaded from the text files of earlier versions */
+struct index_level
+{
+	INT ell;
+	string index_name;
+	INT g;
+	bool legacy;
+	const index_file::header * file;
+	uint64_t file_size;
+	const INT * RSA;
+	const INT * RLCP;
+	const INT * LSA;
+	const INT * LLCP;
+	rmq_succinct_sct<> lrmq;
+	rmq_succinct_sct<> rrmq;
+};
  
-INT bd_anchors( unsigned char * seq, INT pos, INT ell, uint64_t k, unordered_set<INT> &anchors, uint64_t * rank, uint64_t power );
-INT red_minlexrot( unsigned char * X, INT n, uint64_t r, uint64_t power );
-INT compute_anchors(char * arg1, unordered_set<INT> &text_anchors, INT text_size, INT block, INT ell, INT k, uint64_t power);
-INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsigned char * text_string, unordered_set<INT> &text_anchors, INT * RSA, INT * RLCP, INT * LSA, INT * LLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, char * arg0, char * arg1, INT ram_use );
-INT query(char * arg3, unsigned char * text_string, string output_filename, INT text_size, INT * LSA, INT * LLCP, INT * RSA, INT * RLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, INT g, INT ell, INT power, INT k );
-pair<INT,INT> rev_pattern_matching ( unsigned char * w, unsigned char * a, INT * SA, INT * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size );
-pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, INT * SA, INT * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size );
+INT bd_anchors( unsigned char * seq, INT n, INT pos, INT ell, uint64_t k, vector<INT> &anchors, uint64_t * FP, min_queue &min_fp, rotation::tie_breaker &ties, anchor_report::ties * tie_stats );
+INT red_minlexrot( unsigned char * X, INT n, uint64_t r, const anchor_hash::policy &hash_policy, min_queue &draws, uint64_t * FP );
+vector<pair<INT,INT>> anchor_blocks( unsigned char * text_string, INT text_size, INT block, INT min_ell, INT max_ell, const bool * masked );
+INT compute_anchors(unsigned char * text_string, vector<vector<INT>> &level_anchors, INT text_size, INT block, const vector<INT> &ells, INT k, const anchor_hash::policy &hash_policy, INT threads, const bool * masked, anchor_report * report, chunk_hashes * chunks);
+uint64_t search_base(unsigned char * text_string, INT text_size, INT block, const vector<INT> &ells, INT k, const INT * alphabet_hist, INT threads, const bool * masked, INT seeds, INT sample, vector<INT> &counts);
+INT legacy_anchors( string index_name );
+INT compute_index( uint64_t hash, string index_name, string sa_name, INT text_size, INT g, unsigned char * text_string, vector<INT> &text_anchors, INT * RSA, INT * RLCP, INT * LSA, INT * LLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, char * arg0, char * arg1, INT ram_use, build_strategy::kind strategy );
+INT query(char * arg3, unsigned char * text_string, string output_filename, INT text_size, vector<index_level> &levels, const anchor_hash::policy &hash_policy, INT k );
+pair<INT,INT> rev_pattern_matching ( unsigned char * w, unsigned char * a, const INT * SA, const INT * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size );
+pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, const INT * SA, const INT * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size );
 
@@ -17,12 +17,17 @@
 **/
 
 #include <unordered_set>
+#include <chrono>
 #include "utils.h"
 #include "stream.h"
 #include "uint40.h"
 #include <math.h>
 #include "rrbda-index_ext.h"
 #include "krfp.h"
+#include "rotation.h"
+#include "min_queue.h"
+#include "anchor_hash.h"
+#include "anchor_report.h"
 
 using namespace std;
 using namespace sdsl;
@@ -35,31 +40,14 @@ using namespace sdsl;
 #include <divsufsort.h>                                       	  // include header for suffix sort
 #endif
 
-/* Computes the bd-anchors of a string of length n */
-INT bd_anchors(  unsigned char * seq, INT pos, INT ell, uint64_t k, unordered_set<INT> &anchors, uint64_t * FP, uint64_t power)
+/* Computes the bd-anchors of a string of length n >= ell from the fingerprints FP of its k-mers, adding its tie statistics to tie_stats if it is not NULL */
+INT bd_anchors(  unsigned char * seq, INT n, INT pos, INT ell, uint64_t k, vector<INT> &anchors, uint64_t * FP, min_queue &min_fp, rotation::tie_breaker &ties, anchor_report::ties * tie_stats )
 {
 
 	uint64_t w = ell;
-	INT n = strlen ( (char*) seq );
-	uint64_t fp = 0;
-
-        for(INT j = 0; j<k; j++)
-                fp =  karp_rabin_hashing::concat( fp, seq[j] , 1 );
-
-        FP[0] = fp; 
-        
-        deque<pair<uint64_t,utils::FP_>> min_fp = {};
-	vector<utils::FP_> minimizers;
-	
-        // find all fingerprints for all k substrings
-        for( uint64_t j = 1; j<=n-k; j++)
-        {
-                fp = karp_rabin_hashing::concat( fp, seq[j+k-1] , 1 );
-                fp = karp_rabin_hashing::subtract_fast( fp, seq[j-1] , power );
-
-                FP[j] = fp; 
-               
-        }
+
+	min_fp.clear();
+	ties.reset( seq );
 
 	/* Compute reduced bd-anchors for every window of size ell */
 	for( uint64_t j = 0; j<=n-w; j++ )
@@ -67,193 +55,247 @@ INT bd_anchors(  unsigned char * seq, INT pos, INT ell, uint64_t k, unordered_se
 		if( j == 0 )
 		{
 			for ( uint64_t l = 0; l <= w-k; l++) 
-		   	{
-		 		while ( !min_fp.empty() && FP[l] < min_fp.back().first )
-		 			min_fp.pop_back();
-		 
-			       	utils::FP_ potential_bd;
-				potential_bd.start_pos = l;
-				potential_bd.fp_pos = l;
-							
-				min_fp.push_back(std::make_pair(FP[l], potential_bd));
-		    	}
-		
+				min_fp.push( FP[l], l );
 		}
 		else
 		{
-			while( min_fp.front().second.start_pos < j )
-				min_fp.pop_front();
-				
-			while (!min_fp.empty() && min_fp.back().first > FP[j+w-k])
-				min_fp.pop_back();
-					
-			utils::FP_ potential_bd;
-			potential_bd.start_pos = j+w-k;
-			potential_bd.fp_pos = j+w-k;
-				
-			min_fp.push_back(std::make_pair(FP[j+w-k], potential_bd));
-			
+			min_fp.pop_before( j );
+			min_fp.push( FP[j+w-k], j+w-k );
 		}
-			
-		uint64_t min_ = min_fp.at(0).first;
-		for(uint64_t i = 0; i<min_fp.size(); i++)
-		{
-			if( min_fp.at(i).first == min_ )
-			{
-				minimizers.push_back( min_fp.at(i).second );
-			}
-			else if( min_fp.at(i).first >  min_ )
-				break;
-		}
-		
-		unsigned char a = ' ';
-		unsigned char b = ' ';
-		
-		uint64_t a_pos = 0;
-		uint64_t b_pos = 0;
-		bool cont = false;
 		
 		/* Filter draws if there are more than one minimum fp, otherwise only one potential bd-anchor in window */			
-		if( minimizers.size() > 1 )
+		if( min_fp.tie_count() > 1 )
 		{ 	
-			uint64_t smallest_fp_pos = minimizers.at(0).start_pos;
-		
-       		
-			for(INT i = 1; i<minimizers.size(); i++ )
+			/* A later draw wins when the rotation of the window starting right after its k-mer is not larger than that of the current one */
+			uint64_t smallest_fp_pos = min_fp.tie_pos(0);
+			uint64_t compared = ties.compared();
+			for(INT i = 1; i<min_fp.tie_count(); i++ )
 			{
-				a_pos = smallest_fp_pos+k;
-				b_pos = minimizers.at(i).start_pos+k;
-				
-				cont = false;
-			
-				for(uint64_t c = k; c<w; c++)
-				{
-					a = seq[a_pos];
-					b = seq[b_pos];
-
-					if( b_pos >= j + w )
-					{
-						b_pos = j;
-						cont = true;
-						break;
-					}
-					
-					if( b < a )
-					{
-						smallest_fp_pos =  minimizers.at(i).start_pos;
-						break;
-					}
-					else if( b > a )
-						break;
-					
-					a_pos++;
-					b_pos++;
-				}
-				
-				if( cont == true )
-				{
-					cont  = false;
-					for(uint64_t c = 0; c<w; c++)
-					{
-		      				a = seq[a_pos];
-						b = seq[b_pos];
-							
-						if( a_pos >= j + w )
-						{
-							a_pos = j;
-							cont = true;
-							break;
-						}
-					
-						if( b < a )
-						{
-							smallest_fp_pos =  minimizers.at(i).start_pos;
-							break;
-						}
-						else if( b > a )
-							break;
-						
-						a_pos++;
-						b_pos++;
-					}
-				}
-				
-				
-				if( cont == true )
-				{
-					for(INT c = 0; c<w; c++)
-					{
-		      				a = seq[a_pos];
-						b = seq[b_pos];
-							
-						if( b_pos >= j + w || b < a )
-						{
-							smallest_fp_pos =  minimizers.at(i).start_pos;
-							break;
-						}
-						else if( b > a )
-							break;
-						
-						a_pos++;
-						b_pos++;
-					}
-					
-				}	
-			}	
+				if( ties.later_wins( seq, j, w, k, smallest_fp_pos, min_fp.tie_pos(i) ) )
+					smallest_fp_pos = min_fp.tie_pos(i);
+			}
+			if( tie_stats != NULL )
+			{
+				tie_stats->windows++;
+				tie_stats->comparisons += ties.compared() - compared;
+			}
 			
-			anchors.insert( smallest_fp_pos+pos );
+			if( anchors.empty() || anchors.back() != (INT) smallest_fp_pos+pos )
+				anchors.push_back( smallest_fp_pos+pos );
 		}	
 		else 
 		{
-			anchors.insert( minimizers.at(0).start_pos+pos );
+			if( anchors.empty() || anchors.back() != min_fp.tie_pos(0)+pos )
+				anchors.push_back( min_fp.tie_pos(0)+pos );
 		}
-			
-		
-		minimizers.clear();
 	}
 						
 	return 0;
 }
 
 
-INT compute_anchors(char * arg1, unordered_set<INT> &text_anchors, INT text_size, INT block, INT ell, INT k, uint64_t power)
+/* Splits the text, or its unmasked runs, into (start, length) blocks overlapping by max_ell-1 symbols */
+vector<pair<INT,INT>> anchor_blocks( unsigned char * text_string, INT text_size, INT block, INT min_ell, INT max_ell, const bool * masked )
 {
+	INT step = block - max_ell + 1;
 
-   	ifstream is_block;
-	is_block.open (arg1, ios::in | ios::binary);
-	unsigned char * text_block = ( unsigned char * ) malloc (  ( block + 1 ) * sizeof ( unsigned char ) );
-	uint64_t * rank = ( uint64_t * ) malloc( ( block  ) *  sizeof( uint64_t ) );
-	unsigned char * suffix_block = ( unsigned char * ) malloc (  ( ell  ) * sizeof ( unsigned char ) );
-		
-	unsigned char c = 0;
-	INT count = 0;
-	INT pos = 0;
-	 	
-	for (INT i = 0; i < text_size; i++)
-	{	
-		is_block.read(reinterpret_cast<char*>(&c), 1);
-			
-		text_block[count] = (unsigned char) c ;
-		count++;
-		if( count == block || i == text_size - 1 )
+	vector<pair<INT,INT>> block_list;
+	INT start = 0;
+	while( start < text_size )
+	{
+		INT end = text_size;
+		if( masked != NULL )
+		{
+			end = start;
+			while( end < text_size && !masked[text_string[end]] )
+				end++;
+		}
+
+		if( end - start >= min_ell )
 		{
-			text_block[count] = '\0';
-					
-			bd_anchors( text_block, pos, ell, k, text_anchors, rank, power );
-					
-			memcpy( &suffix_block[0], &text_block[ block - ell + 1], ell -1 );
-			memcpy( &text_block[0], &suffix_block[0], ell -1 );
-					
-			pos = pos + ( block - ell + 1 );
-			count = ell - 1;	
+			INT blocks = 1;
+			if( end - start > block )
+				blocks = ( end - start - block + step - 1 ) / step + 1;
+
+			for (INT b = 0; b < blocks; b++)
+			{
+				INT pos = start + b * step;
+				block_list.push_back( make_pair( pos, std::min( block, end - pos ) ) );
+			}
 		}
+
+		start = end + 1;
+	}
+
+	return block_list;
+}
+
+
+/* Computes the sorted bd-anchors of each order of ells into level_anchors, block by block in parallel, along with the chunk fingerprints of chunks if it is not NULL */
+INT compute_anchors(unsigned char * text_string, vector<vector<INT>> &level_anchors, INT text_size, INT block, const vector<INT> &ells, INT k, const anchor_hash::policy &hash_policy, INT threads, const bool * masked, anchor_report * report, chunk_hashes * chunks)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	INT levels = ells.size();
+	vector<pair<INT,INT>> block_list = anchor_blocks( text_string, text_size, block, ells.front(), ells.back(), masked );
+
+	INT blocks = block_list.size();
+	vector<vector<vector<INT>>> block_anchors( levels, vector<vector<INT>>( blocks ) );
+
+	if( report != NULL )
+	{
+		report->blocks.assign( blocks, anchor_report::block() );
+		for (INT b = 0; b < blocks; b++)
+		{
+			report->blocks[b].pos = block_list[b].first;
+			report->blocks[b].length = block_list[b].second;
+			report->blocks[b].anchors.assign( levels, 0 );
+			report->blocks[b].tie_stats.assign( levels, anchor_report::ties{ 0, 0 } );
+		}
+	}
+
+	#pragma omp parallel num_threads( threads )
+	{
+		uint64_t * rank = ( uint64_t * ) malloc( ( block  ) *  sizeof( uint64_t ) );
+		min_queue min_fp( ells.back() - k + 1 );
+		rotation::tie_breaker ties( ells.back() );
+
+		#pragma omp for schedule(dynamic)
+		for (INT b = 0; b < blocks; b++)
+		{
+			INT pos = block_list[b].first;
+			INT count = block_list[b].second;
+			std::chrono::steady_clock::time_point start_block = std::chrono::steady_clock::now();
+
+			hash_policy.fingerprints( &text_string[pos], count, rank );
+
+			for (INT l = 0; l < levels && ells[l] <= count; l++)
+			{
+				vector<INT> &anchors = block_anchors[l][b];
+				bd_anchors( &text_string[pos], count, pos, ells[l], k, anchors, rank, min_fp, ties, report == NULL ? NULL : &report->blocks[b].tie_stats[l] );
+
+				/* Anchors of a block come out nearly sorted */
+				sort( anchors.begin(), anchors.end() );
+				anchors.erase( unique( anchors.begin(), anchors.end() ), anchors.end() );
+
+				if( report != NULL )
+					report->blocks[b].anchors[l] = anchors.size();
+			}
+
+			if( chunks != NULL )
+				chunks->compute( text_string, ( b == 0 ) ? 0 : pos, ( b + 1 < blocks ) ? block_list[b+1].first : text_size );
+
+			if( report != NULL )
+				report->blocks[b].seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start_block ).count();
+		}
+
+		free( rank );
+	}
+
+	/* Consecutive blocks can only share anchors in their overlap, so each block is merged with the tail of the anchors collected so far */
+	level_anchors.assign( levels, vector<INT>() );
+	for (INT l = 0; l < levels; l++)
+	{
+		vector<INT> &text_anchors = level_anchors[l];
+
+		INT total = 0;
+		for (INT b = 0; b < blocks; b++)
+			total += block_anchors[l][b].size();
+
+		text_anchors.reserve( total );
+		for (INT b = 0; b < blocks; b++)
+		{
+			if( block_anchors[l][b].empty() )
+				continue;
+
+			auto tail = lower_bound( text_anchors.begin(), text_anchors.end(), block_anchors[l][b].front() ) - text_anchors.begin();
+			auto middle = text_anchors.size();
+
+			text_anchors.insert( text_anchors.end(), block_anchors[l][b].begin(), block_anchors[l][b].end() );
+			vector<INT>().swap( block_anchors[l][b] );
+
+			inplace_merge( text_anchors.begin() + tail, text_anchors.begin() + middle, text_anchors.end() );
+			text_anchors.erase( unique( text_anchors.begin() + tail, text_anchors.end() ), text_anchors.end() );
+		}
+		text_anchors.shrink_to_fit();
+	}
+
+	if( report != NULL )
+	{
+		report->text_size = text_size;
+		report->k = k;
+		report->block_size = block;
+		report->threads = threads;
+		report->policy = hash_policy.name();
+		report->seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+		report->summarize( ells, level_anchors );
 	}
-		
-	is_block.close();
-	free( text_block );
-	free( suffix_block );
-	free( rank );	
 
 	return 0;
-	
-}	
+}
+
+
+/* Returns the base of seeds candidates giving the fewest bd-anchors on a sample of the text */
+uint64_t search_base(unsigned char * text_string, INT text_size, INT block, const vector<INT> &ells, INT k, const INT * alphabet_hist, INT threads, const bool * masked, INT seeds, INT sample, vector<INT> &counts)
+{
+	INT levels = ells.size();
+	vector<pair<INT,INT>> block_list = anchor_blocks( text_string, text_size, block, ells.front(), ells.back(), masked );
+
+	INT blocks = block_list.size();
+	INT sampled = blocks;
+	if( sample > 0 )
+		sampled = std::min( blocks, std::max( ( INT ) 1, ( sample + block - 1 ) / block ) );
+
+	vector<pair<INT,INT>> sample_list( sampled );
+	for (INT b = 0; b < sampled; b++)
+		sample_list[b] = block_list[( int64_t ) b * blocks / sampled];
+
+	uint64_t first = karp_rabin_hashing::hash_variable;
+	uint64_t best = first;
+	INT best_g = 0;
+	counts.clear();
+	for (INT s = 0; s < seeds; s++)
+	{
+		uint64_t base = ( s == 0 ) ? first : karp_rabin_hashing::rand_mod_mersenne( 61 );
+		anchor_hash::policy hash_policy( k, base, alphabet_hist, masked );
+
+		INT g = 0;
+		#pragma omp parallel num_threads( threads ) reduction(+:g)
+		{
+			uint64_t * rank = ( uint64_t * ) malloc( ( block  ) *  sizeof( uint64_t ) );
+			min_queue min_fp( ells.back() - k + 1 );
+			rotation::tie_breaker ties( ells.back() );
+			vector<INT> anchors;
+
+			#pragma omp for schedule(dynamic)
+			for (INT b = 0; b < sampled; b++)
+			{
+				INT pos = sample_list[b].first;
+				INT count = sample_list[b].second;
+
+				hash_policy.fingerprints( &text_string[pos], count, rank );
+
+				for (INT l = 0; l < levels && ells[l] <= count; l++)
+				{
+					anchors.clear();
+					bd_anchors( &text_string[pos], count, pos, ells[l], k, anchors, rank, min_fp, ties, NULL );
+
+					sort( anchors.begin(), anchors.end() );
+					g += unique( anchors.begin(), anchors.end() ) - anchors.begin();
+				}
+			}
+
+			free( rank );
+		}
+
+		counts.push_back( g );
+		if( s == 0 || g < best_g )
+		{
+			best = base;
+			best_g = g;
+		}
+	}
+
+	karp_rabin_hashing::init( best );
+	return best;
+}
@@ -1,7 +1,11 @@
 #include "./utils.h"
 
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -83,6 +87,70 @@ bool file_exists(std::string fname) {
   return ret;
 }
 
+// Maps the first size bytes of a file read-only into memory. The mapping is
+// followed by a zero-filled page, so data[size] is always a valid 0 byte.
+unsigned char *file_map(std::string fname, long size) {
+  long page = sysconf(_SC_PAGESIZE);
+  long length = ((size + page) / page) * page;
+
+  unsigned char *data = (unsigned char *) mmap(NULL, length,
+      PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Error: mmap of %ld bytes failed: %s\n",
+        length, strerror(errno));
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (size > 0) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd == -1) {
+      std::perror(fname.c_str());
+      std::exit(EXIT_FAILURE);
+    }
+    if (mmap(data, size, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+          fd, 0) == MAP_FAILED) {
+      fprintf(stderr, "Error: mmap of %s failed: %s\n",
+          fname.c_str(), strerror(errno));
+      std::exit(EXIT_FAILURE);
+    }
+    close(fd);
+    madvise(data, size, MADV_WILLNEED);
+  }
+
+  return data;
+}
+
+void file_unmap(unsigned char *data, long size) {
+  long page = sysconf(_SC_PAGESIZE);
+  munmap(data, ((size + page) / page) * page);
+}
+
+// Maps the whole of fname read-only and shared, so that the processes
+// reading a file share its pages; NULL if it cannot be opened or mapped.
+unsigned char *file_map_shared(std::string fname, long &size) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  size = st.st_size;
+
+  void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  return (unsigned char *) data;
+}
+
+void file_unmap_shared(const unsigned char *data, long size) {
+  munmap((void *) data, size);
+}
+
 void find_stxxl_config() {
   if (file_exists("./.stxxl")) {
     fprintf(stderr, "STXXL config file detected.\n");
@@ -0,0 +1,108 @@
+/* Throughput of the Karp-Rabin fingerprint kernels of krfp.cc: every thread computes the fingerprints of all k-mers of its own random DNA text of length n with the serial concat/subtract_fast loop and with the scalar, AVX2 and AVX-512 kernels, and the best of the rounds is reported per core. The kernels must give the fingerprints of the serial loop */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <omp.h>
+
+#include "utils.h"
+#include "krfp.h"
+
+using namespace std;
+
+typedef void ( * kernel )( const unsigned char *, const uint64_t, const uint64_t, const uint64_t, const uint64_t, uint64_t * );
+
+/* The fingerprints of seq[0..n) one after the other, as bd_anchors computed them before the kernels; base must be the one given to karp_rabin_hashing::init() */
+void fingerprints_serial( const unsigned char * seq, const uint64_t n, const uint64_t k, const uint64_t, const uint64_t power, uint64_t * FP )
+{
+	uint64_t fp = 0;
+	for( uint64_t i = 0; i < k; i++ )
+		fp = karp_rabin_hashing::concat( fp, seq[i], 1 );
+	FP[0] = fp;
+	for( uint64_t j = 1; j + k <= n; j++ )
+	{
+		fp = karp_rabin_hashing::concat( fp, seq[j+k-1], 1 );
+		fp = karp_rabin_hashing::subtract_fast( fp, seq[j-1], power );
+		FP[j] = fp;
+	}
+}
+
+int main( int argc, char ** argv )
+{
+	INT n = ( argc > 1 ) ? atol( argv[1] ) : 10000000;
+	INT k = ( argc > 2 ) ? atol( argv[2] ) : 12;
+	INT threads = ( argc > 3 ) ? atol( argv[3] ) : 1;
+	INT rounds = ( argc > 4 ) ? atol( argv[4] ) : 3;
+	if( n < k || k < 1 || threads < 1 || rounds < 1 )
+	{
+		fprintf( stderr, "usage: %s [<n> [<k> [<threads> [<rounds>]]]]\n", argv[0] );
+		return 1;
+	}
+
+	uint64_t base = karp_rabin_hashing::init();
+	uint64_t power = karp_rabin_hashing::pow_mod_mersenne( base, k, 61 );
+
+	vector<vector<unsigned char>> text( threads, vector<unsigned char>( n ) );
+	vector<vector<uint64_t>> expected( threads, vector<uint64_t>( n - k + 1 ) );
+	vector<vector<uint64_t>> FP( threads, vector<uint64_t>( n - k + 1 ) );
+	for( INT t = 0; t < threads; t++ )
+	{
+		unsigned int seed = t + 1;
+		for( INT i = 0; i < n; i++ )
+			text[t][i] = "ACGT"[ rand_r( &seed ) % 4 ];
+	}
+
+	const char * names[4] = { "serial", "scalar", "avx2", "avx512" };
+	kernel kernels[4] = { fingerprints_serial, karp_rabin_hashing::fingerprints_scalar, karp_rabin_hashing::fingerprints_avx2, karp_rabin_hashing::fingerprints_avx512 };
+	bool supported[4] = { true, true, ( bool ) __builtin_cpu_supports( "avx2" ), ( bool ) __builtin_cpu_supports( "avx512f" ) };
+
+	cout<<"n = "<<n<<", k = "<<k<<", "<<threads<<" thread(s), best of "<<rounds<<" round(s)"<<endl;
+
+	double serial_rate = 0;
+	for( int m = 0; m < 4; m++ )
+	{
+		if( !supported[m] )
+		{
+			cout<<names[m]<<": not supported by this CPU"<<endl;
+			continue;
+		}
+
+		/* Every thread times its own runs, so the throughput is that of one core while all of them run */
+		vector<double> best( threads, 0 );
+		#pragma omp parallel num_threads( threads )
+		{
+			INT t = omp_get_thread_num();
+			uint64_t * out = ( m == 0 ) ? expected[t].data() : FP[t].data();
+			for( INT r = 0; r < rounds; r++ )
+			{
+				#pragma omp barrier
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				kernels[m]( text[t].data(), n, k, base, power, out );
+				double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+				if( r == 0 || seconds < best[t] )
+					best[t] = seconds;
+			}
+		}
+
+		double rate = 0;
+		bool same = true;
+		for( INT t = 0; t < threads; t++ )
+		{
+			rate += n / best[t] / 1e6;
+			if( m > 0 )
+				same = same && memcmp( FP[t].data(), expected[t].data(), ( n - k + 1 ) * sizeof( uint64_t ) ) == 0;
+		}
+		rate /= threads;
+		if( m == 0 )
+			serial_rate = rate;
+
+		cout<<names[m]<<": "<<rate<<" MB/s per core (x"<<rate / serial_rate<<" the serial loop)"<<( same ? "" : ", WRONG FINGERPRINTS" )<<endl;
+		if( !same )
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+/* The radix sort of radix_sort.h against std::sort, on the (fingerprint, member) pairs group() of ssa.cc sorts: random 61-bit keys, each drawn for the given number of pairs, of 10^4 to 1.5*10^6 pairs. With threads, parallel_sort() is timed against __gnu_parallel::sort, as in the two backends of group(). The best of the rounds is reported, and both must give the same order */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <parallel/algorithm>
+#include <random>
+
+#include "utils.h"
+#include "radix_sort.h"
+
+using namespace std;
+
+int main( int argc, char ** argv )
+{
+	INT per_key = ( argc > 1 ) ? atol( argv[1] ) : 1;
+	INT threads = ( argc > 2 ) ? atol( argv[2] ) : 1;
+	INT rounds = ( argc > 3 ) ? atol( argv[3] ) : 5;
+	if( per_key < 1 || threads < 1 || rounds < 1 )
+	{
+		fprintf( stderr, "usage: %s [<pairs per key> [<threads> [<rounds>]]]\n", argv[0] );
+		return 1;
+	}
+
+	const int key_bits = 61;
+	const INT sizes[4] = { 10000, 100000, 1000000, 1500000 };
+
+	cout<<per_key<<" pair(s) per key, "<<threads<<" thread(s), best of "<<rounds<<" round(s)"<<endl;
+
+	for( int si = 0; si < 4; si++ )
+	{
+		INT n = sizes[si];
+		vector<radix_sort::item> input( n );
+		uint64_t state = 88172645463325252ULL + n;
+		uint64_t key = 0;
+		for( INT i = 0; i < n; i++ )
+		{
+			if( i % per_key == 0 )
+			{
+				state ^= state << 13;
+				state ^= state >> 7;
+				state ^= state << 17;
+				key = state & ( ( ( uint64_t ) 1 << key_bits ) - 2 );
+			}
+			input[i] = radix_sort::item( key, i );
+		}
+		shuffle( input.begin(), input.end(), mt19937_64( n ) );
+
+		double best[2] = { 0, 0 };
+		vector<radix_sort::item> sorted[2];
+		for( INT r = 0; r < rounds; r++ )
+			for( int m = 0; m < 2; m++ )
+			{
+				sorted[m] = input;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				if( m == 0 )
+				{
+					if( threads > 1 )
+						__gnu_parallel::sort( sorted[m].begin(), sorted[m].end(), __gnu_parallel::default_parallel_tag( threads ) );
+					else
+						sort( sorted[m].begin(), sorted[m].end() );
+				}
+				else
+					radix_sort::parallel_sort( sorted[m].data(), n, key_bits, threads );
+				double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+				if( r == 0 || seconds < best[m] )
+					best[m] = seconds;
+			}
+
+		bool same = sorted[0] == sorted[1];
+		cout<<n<<" pairs: std::sort "<<best[0] * 1e3<<" ms, radix sort "<<best[1] * 1e3<<" ms (x"<<best[0] / best[1]<<")"<<( same ? "" : ", DIFFERENT ORDER" )<<endl;
+		if( !same )
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/* Tie-breaking of rotation.h on periodic texts, where every window has ties: for windows of length w and k-mers of length k over a text of period p, the k-mers at the positions that are multiples of p are taken as the tied minima of each window, and the winner is found once with rotation::compare on every pair and once with rotation::tie_breaker, as bd_anchors() does. The time per window, the symbol pairs tie_breaker compares per window, and a check that both find the same winners are reported */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "utils.h"
+#include "rotation.h"
+
+using namespace std;
+
+int main( int argc, char ** argv )
+{
+	INT n = ( argc > 1 ) ? atol( argv[1] ) : 20000;
+	INT rounds = ( argc > 2 ) ? atol( argv[2] ) : 3;
+	if( n < 2000 || rounds < 1 )
+	{
+		fprintf( stderr, "usage: %s [<n> (at least 2000) [<rounds>]]\n", argv[0] );
+		return 1;
+	}
+
+	const INT k = 8;
+	const INT widths[3] = { 64, 300, 1000 };
+	const INT periods[4] = { 1, 4, 7, 50 };
+
+	cout<<"n = "<<n<<", k = "<<k<<", best of "<<rounds<<" round(s)"<<endl;
+
+	for( int wi = 0; wi < 3; wi++ )
+		for( int pi = 0; pi < 4; pi++ )
+		{
+			INT w = widths[wi];
+			INT p = periods[pi];
+
+			vector<unsigned char> T( n );
+			unsigned int seed = p;
+			for( INT i = 0; i < p; i++ )
+				T[i] = "ACGT"[ rand_r( &seed ) % 4 ];
+			for( INT i = p; i < n; i++ )
+				T[i] = T[i-p];
+
+			double best[2] = { 0, 0 };
+			uint64_t winners[2] = { 0, 0 };
+			uint64_t compared = 0;
+			rotation::tie_breaker ties( w );
+
+			for( INT r = 0; r < rounds; r++ )
+				for( int m = 0; m < 2; m++ )
+				{
+					uint64_t sum = 0;
+					ties.reset( T.data() );
+					uint64_t before = ties.compared();
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+					for( INT j = 0; j + w <= n; j++ )
+					{
+						INT a = ( ( j + p - 1 ) / p ) * p;
+						for( INT b = a + p; b <= j + w - k; b += p )
+						{
+							bool later;
+							if( m == 0 )
+								later = rotation::compare( &T[j], w, ( a + k - j ) % w, ( b + k - j ) % w ) >= 0;
+							else
+								later = ties.later_wins( T.data(), j, w, k, a, b );
+							if( later )
+								a = b;
+						}
+						sum += a;
+					}
+
+					double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+					if( r == 0 || seconds < best[m] )
+						best[m] = seconds;
+					winners[m] = sum;
+					if( m == 1 )
+						compared = ties.compared() - before;
+				}
+
+			INT windows = n - w + 1;
+			cout<<"w = "<<w<<", p = "<<p<<": compare "<<best[0] / windows * 1e9<<" ns/window, tie_breaker "<<best[1] / windows * 1e9<<" ns/window and "<<( double ) compared / windows<<" symbols/window"<<( winners[0] == winners[1] ? "" : ", DIFFERENT WINNERS" )<<endl;
+			if( winners[0] != winners[1] )
+				return 1;
+		}
+
+	return 0;
+}
@@ -0,0 +1,35 @@
+#!/bin/bash
+# Builds the index of a text starting with a repeated block by the sparse and
+# the full strategy and checks that they report the same occurrences. The
+# suffixes of the reversed text then share prefixes reaching past its end,
+# which the left compacted trie must order correctly.
+#
+# usage: ./data/regression.sh [<rrbda-index_int>]
+
+EXE=${1:-./rrbda-index_int}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+awk 'BEGIN {
+	srand( 7 );
+	for( i = 0; i < 5000; i++ ) block = block substr( "ACGT", int( rand() * 4 ) + 1, 1 );
+	for( i = 0; i < 30000; i++ ) rest = rest substr( "ACGT", int( rand() * 4 ) + 1, 1 );
+	text = block block rest;
+	printf( "%s", text ) > "'"$DIR"'/text";
+	for( i = 0; i < 200; i++ ) print substr( text, int( rand() * ( length( text ) - 200 ) ) + 1, 32 + int( rand() * 100 ) ) > "'"$DIR"'/patterns";
+	print substr( text, 1, 100 ) > "'"$DIR"'/patterns";
+	print substr( text, 5001, 100 ) > "'"$DIR"'/patterns";
+}'
+
+for strategy in sparse full; do
+	if ! $EXE "$DIR/text" 32 "$DIR/patterns" 100000 "$DIR/out.$strategy" "$DIR/index.$strategy" -c $strategy > "$DIR/log.$strategy" 2>&1; then
+		echo "FAILED: -c $strategy did not complete"
+		exit 1
+	fi
+done
+
+if ! cmp -s "$DIR/out.sparse" "$DIR/out.full"; then
+	echo "FAILED: -c sparse and -c full report different occurrences"
+	exit 1
+fi
+echo "OK"
@@ -0,0 +1,132 @@
+#ifndef __ANCHOR_REPORT_H_INCLUDED
+#define __ANCHOR_REPORT_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "utils.h"
+
+/* Statistics of the bd-anchor computation, written as JSON for capacity planning and for tuning ell and the block size. They are only collected when compute_anchors() is given a report, so a build without one pays a single test per window that needs tie-breaking */
+class anchor_report
+{
+public:
+	/* Windows of one block and one order whose minimum k-mer was not unique, and the symbol pairs compared to break their ties */
+	struct ties
+	{
+		uint64_t windows;
+		uint64_t comparisons;
+	};
+
+	/* One block of anchor_blocks(); anchors and tie_stats are per order */
+	struct block
+	{
+		INT pos;
+		INT length;
+		double seconds;
+		std::vector<INT> anchors;
+		std::vector<ties> tie_stats;
+	};
+
+	/* One order; gap_hist[i] counts the gaps between consecutive anchors in [2^i, 2^(i+1)) */
+	struct level
+	{
+		INT ell;
+		INT g;
+		INT max_gap;
+		std::vector<uint64_t> gap_hist;
+		uint64_t tie_windows;
+		uint64_t comparisons;
+	};
+
+	INT text_size;
+	INT k;
+	INT block_size;
+	INT threads;
+	std::string policy;
+	double seconds;
+	std::vector<level> levels;
+	std::vector<block> blocks;
+
+	/* Sums the tie statistics of the blocks and computes the gaps of the sorted anchors of each order */
+	void summarize( const std::vector<INT> &ells, const std::vector<std::vector<INT>> &level_anchors )
+	{
+		levels.assign( ells.size(), level() );
+		for( size_t l = 0; l < ells.size(); l++ )
+		{
+			level &lv = levels[l];
+			const std::vector<INT> &anchors = level_anchors[l];
+			lv.ell = ells[l];
+			lv.g = anchors.size();
+			lv.max_gap = 0;
+			lv.tie_windows = 0;
+			lv.comparisons = 0;
+
+			for( size_t i = 1; i < anchors.size(); i++ )
+			{
+				INT gap = anchors[i] - anchors[i-1];
+				size_t bucket = 63 - __builtin_clzll( ( uint64_t ) gap );
+				if( bucket >= lv.gap_hist.size() )
+					lv.gap_hist.resize( bucket + 1, 0 );
+				lv.gap_hist[bucket]++;
+				if( gap > lv.max_gap )
+					lv.max_gap = gap;
+			}
+
+			for( size_t b = 0; b < blocks.size(); b++ )
+			{
+				lv.tie_windows += blocks[b].tie_stats[l].windows;
+				lv.comparisons += blocks[b].tie_stats[l].comparisons;
+			}
+		}
+	}
+
+	void write_json( const std::string &file_name ) const
+	{
+		std::ofstream out( file_name );
+
+		out << "{\n";
+		out << "  \"text_size\": " << text_size << ",\n";
+		out << "  \"k\": " << k << ",\n";
+		out << "  \"block_size\": " << block_size << ",\n";
+		out << "  \"threads\": " << threads << ",\n";
+		out << "  \"policy\": \"" << policy << "\",\n";
+		out << "  \"seconds\": " << seconds << ",\n";
+		out << "  \"throughput_mb_per_s\": " << throughput( text_size, seconds ) << ",\n";
+
+		out << "  \"levels\": [\n";
+		for( size_t l = 0; l < levels.size(); l++ )
+		{
+			const level &lv = levels[l];
+			out << "    {\"ell\": " << lv.ell << ", \"g\": " << lv.g << ", \"density\": " << ( double ) lv.g / text_size;
+			out << ", \"max_gap\": " << lv.max_gap << ", \"tie_windows\": " << lv.tie_windows << ", \"comparisons\": " << lv.comparisons;
+			out << ", \"gap_histogram\": [";
+			for( size_t i = 0; i < lv.gap_hist.size(); i++ )
+				out << ( i ? ", " : "" ) << "{\"from\": " << ( ( uint64_t ) 1 << i ) << ", \"count\": " << lv.gap_hist[i] << "}";
+			out << "]}" << ( l + 1 < levels.size() ? "," : "" ) << "\n";
+		}
+		out << "  ],\n";
+
+		out << "  \"blocks\": [\n";
+		for( size_t b = 0; b < blocks.size(); b++ )
+		{
+			const block &bl = blocks[b];
+			out << "    {\"pos\": " << bl.pos << ", \"length\": " << bl.length << ", \"seconds\": " << bl.seconds;
+			out << ", \"throughput_mb_per_s\": " << throughput( bl.length, bl.seconds ) << ", \"anchors\": [";
+			for( size_t l = 0; l < bl.anchors.size(); l++ )
+				out << ( l ? ", " : "" ) << bl.anchors[l];
+			out << "]}" << ( b + 1 < blocks.size() ? "," : "" ) << "\n";
+		}
+		out << "  ]\n";
+		out << "}\n";
+	}
+
+private:
+	static double throughput( INT length, double seconds )
+	{
+		return seconds > 0 ? length / seconds / ( 1024.0 * 1024.0 ) : 0;
+	}
+};
+
+#endif  // __ANCHOR_REPORT_H_INCLUDED
@@ -0,0 +1,69 @@
+#ifndef __CHUNK_HASHES_H_INCLUDED
+#define __CHUNK_HASHES_H_INCLUDED
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "utils.h"
+#include "rolling_hash.h"
+
+/* Karp-Rabin fingerprints of the chunks of length len of a text, forward[J] of T[J*len..(J+1)*len), and of its reversal, reverse[J] of T[n-(J+1)*len..n-J*len) read backwards */
+class chunk_hashes
+{
+public:
+	INT len;
+	INT count;
+	std::vector<uint64_t> forward;
+	std::vector<uint64_t> reverse;
+
+	/* The length of the chunks from which the prefix fingerprint tables of ssa() follow under fp_bytes bytes per text symbol */
+	static INT length( double fp_bytes )
+	{
+		return std::max( ( INT ) 1, ( INT ) ( sizeof( uint64_t ) / fp_bytes ) );
+	}
+
+	/* The bytes of the chunks of one direction of a text of length text_size */
+	static INT bytes( INT text_size, double fp_bytes )
+	{
+		return ( text_size / length( fp_bytes ) ) * ( INT ) sizeof( uint64_t );
+	}
+
+	/* Whether the chunks are worth keeping under -f fp_bytes and a budget of ssa() of memory bytes (0 for none): those of one direction may take at most half of it */
+	static bool fit( INT text_size, double fp_bytes, INT memory )
+	{
+		return fp_bytes > 0 && ( memory == 0 || bytes( text_size, fp_bytes ) <= memory / 2 );
+	}
+
+	chunk_hashes( uint64_t base, INT len, INT text_size ) : len( len ), count( text_size / len ), forward( count ), reverse( count ), text_size( text_size ), kr( base, len )
+	{
+	}
+
+	/* Computes the chunks of both directions that start in T[from..to); over ranges covering the text, every chunk is computed once */
+	void compute( const unsigned char * T, INT from, INT to )
+	{
+		for( INT J = ( from + len - 1 ) / len; J < count && J * len < to; J++ )
+		{
+			const unsigned char * chunk = &T[J * len];
+			uint64_t fp = 0;
+			for( INT i = 0; i < len; i++ )
+				fp = kr.append( fp, chunk[i] );
+			forward[J] = fp;
+		}
+
+		for( INT J = ( text_size - to ) / len; J < count && text_size - ( J + 1 ) * len >= from; J++ )
+		{
+			const unsigned char * chunk = &T[text_size - J * len];
+			uint64_t fp = 0;
+			for( INT i = 1; i <= len; i++ )
+				fp = kr.append( fp, chunk[-i] );
+			reverse[J] = fp;
+		}
+	}
+
+private:
+	INT text_size;
+	karp_rabin_hashing::rolling_hash kr;
+};
+
+#endif  // __CHUNK_HASHES_H_INCLUDED
@@ -0,0 +1,87 @@
+#ifndef __FULL_SA_H_INCLUDED
+#define __FULL_SA_H_INCLUDED
+
+#include <cstdlib>
+#include <sdsl/bit_vectors.hpp>
+
+#include "utils.h"
+
+#ifdef _USE_64
+#include <divsufsort64.h>
+#endif
+
+#ifdef _USE_32
+#include <divsufsort.h>
+#endif
+
+namespace full_sa {
+
+/* Sorts the suffixes of T[0..n) into SA by libdivsufsort */
+inline void suffix_array( const unsigned char * T, INT n, INT * SA )
+{
+#ifdef _USE_64
+	divsufsort64( T, ( saidx64_t * ) SA, n );
+#endif
+
+#ifdef _USE_32
+	divsufsort( T, ( saidx_t * ) SA, n );
+#endif
+}
+
+/* Turns Phi, where Phi[SA[i]] = SA[i-1] and n for the first suffix, into the permuted LCP array: Phi[j] becomes the LCP of the suffix at j and the one before it in SA (Kärkkäinen, Manzini and Puglisi) -- Time is O(n) */
+inline void permuted_lcp( const unsigned char * T, INT n, INT * Phi )
+{
+	INT l = 0;
+	for( INT j = 0; j < n; j++ )
+	{
+		INT p = Phi[j];
+		if( p == n )
+		{
+			Phi[j] = l = 0;
+			continue;
+		}
+		while( j + l < n && p + l < n && T[j + l] == T[p + l] )
+			l++;
+		Phi[j] = l;
+		if( l > 0 )
+			l--;
+	}
+}
+
+/* The compacted trie of the suffixes of T[0..n) at the marked positions, read off the full suffix and LCP arrays of T: SSA gets the marked suffixes in lexicographic order and SLCP the LCP of each with the one before it, 0 for the first, as ssa() computes them. A position j is marked by marked[j], or by marked[n-1-j] if mirrored, so that the anchors of a text mark the suffixes of its reversal -- Time is O(n) besides the suffix sorting, and space 16n bytes */
+inline void compacted_trie( const unsigned char * T, INT n, const sdsl::bit_vector &marked, bool mirrored, INT * SSA, INT * SLCP )
+{
+	INT * SA = ( INT * ) malloc( n * sizeof( INT ) );
+	INT * Phi = ( INT * ) malloc( n * sizeof( INT ) );
+
+	suffix_array( T, n, SA );
+	Phi[ SA[0] ] = n;
+	for( INT i = 1; i < n; i++ )
+		Phi[ SA[i] ] = SA[i-1];
+	permuted_lcp( T, n, Phi );
+
+	/* The LCP of two marked suffixes is the minimum of the LCPs from the first, exclusive, to the second */
+	INT g = 0;
+	INT min_lcp = 0;
+	for( INT i = 0; i < n; i++ )
+	{
+		INT lcp = Phi[ SA[i] ];
+		if( lcp < min_lcp )
+			min_lcp = lcp;
+
+		if( marked[ mirrored ? ( n - 1 ) - SA[i] : SA[i] ] )
+		{
+			SSA[g] = SA[i];
+			SLCP[g] = ( g == 0 ) ? 0 : min_lcp;
+			min_lcp = n;
+			g++;
+		}
+	}
+
+	free( Phi );
+	free( SA );
+}
+
+}  // namespace full_sa
+
+#endif  // __FULL_SA_H_INCLUDED
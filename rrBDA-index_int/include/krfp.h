@@ -57,6 +57,19 @@ const std::uint64_t short_hash, const std::uint64_t right_len);
 std::uint64_t subtract_fast(const std::uint64_t long_hash, 
 const std::uint64_t short_hash, const std::uint64_t power);
 std::uint64_t init();
+std::uint64_t init(const std::uint64_t base);
+void fingerprints(const unsigned char * seq, const std::uint64_t n,
+    const std::uint64_t k, const std::uint64_t base, const std::uint64_t power,
+    std::uint64_t * FP);
+void fingerprints_scalar(const unsigned char * seq, const std::uint64_t n,
+    const std::uint64_t k, const std::uint64_t base, const std::uint64_t power,
+    std::uint64_t * FP);
+void fingerprints_avx2(const unsigned char * seq, const std::uint64_t n,
+    const std::uint64_t k, const std::uint64_t base, const std::uint64_t power,
+    std::uint64_t * FP);
+void fingerprints_avx512(const unsigned char * seq, const std::uint64_t n,
+    const std::uint64_t k, const std::uint64_t base, const std::uint64_t power,
+    std::uint64_t * FP);
 
 //=============================================================================
 // Compute Karp-Rabin hash of a given string.
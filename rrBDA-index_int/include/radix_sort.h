@@ -0,0 +1,99 @@
+#ifndef __RADIX_SORT_H_INCLUDED
+#define __RADIX_SORT_H_INCLUDED
+
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "utils.h"
+
+namespace radix_sort {
+
+/* Ranges this short are left to std::sort */
+constexpr INT cutoff = 64;
+
+typedef std::pair<uint64_t,INT> item;
+
+inline unsigned int digit( const item &x, int shift )
+{
+	return ( x.first >> shift ) & 0xFF;
+}
+
+/* Permutes a[0..n) in place so that the items are grouped by the digit at shift, in increasing order (American flag sort); bucket[d] gets the end of the items with digit d */
+inline void partition( item * a, INT n, int shift, INT * bucket )
+{
+	INT next[256];
+	INT count[256] = { 0 };
+	for( INT i = 0; i < n; i++ )
+		count[ digit( a[i], shift ) ]++;
+
+	INT sum = 0;
+	for( int d = 0; d < 256; d++ )
+	{
+		next[d] = sum;
+		sum += count[d];
+		bucket[d] = sum;
+	}
+
+	for( int d = 0; d < 256; d++ )
+		while( next[d] < bucket[d] )
+		{
+			item x = a[ next[d] ];
+			unsigned int dx = digit( x, shift );
+			while( dx != ( unsigned int ) d )
+			{
+				std::swap( x, a[ next[dx]++ ] );
+				dx = digit( x, shift );
+			}
+			a[ next[d]++ ] = x;
+		}
+}
+
+/* Sorts a[0..n) by the key bits below shift+8, then by the INT, as std::sort does on pairs of equal higher bits */
+inline void sort_from( item * a, INT n, int shift )
+{
+	if( n <= cutoff || shift < 0 )
+	{
+		std::sort( a, a + n );
+		return;
+	}
+
+	INT bucket[256];
+	partition( a, n, shift, bucket );
+
+	INT from = 0;
+	for( int d = 0; d < 256; d++ )
+	{
+		sort_from( a + from, bucket[d] - from, shift - 8 );
+		from = bucket[d];
+	}
+}
+
+/* Sorts a[0..n) in the order of std::sort, for keys smaller than 2^key_bits -- Time is O(n.key_bits/8), plus std::sort on the items of equal keys and on short ranges. Items are ordered by the key 8 bits at a time from the most significant, in place; the lowest bits, which fewer than 8 remain of, are left to std::sort */
+inline void sort( item * a, INT n, int key_bits )
+{
+	sort_from( a, n, key_bits - 8 );
+}
+
+/* As sort(), by the given number of threads: the items are partitioned by their most significant digit, and the 256 buckets are sorted in parallel */
+inline void parallel_sort( item * a, INT n, int key_bits, INT threads )
+{
+	int shift = key_bits - 8;
+	if( threads <= 1 || n <= cutoff || shift < 0 )
+	{
+		sort_from( a, n, shift );
+		return;
+	}
+
+	INT bucket[257];
+	bucket[0] = 0;
+	partition( a, n, shift, bucket + 1 );
+
+	#pragma omp parallel for schedule(dynamic) num_threads( threads )
+	for( int d = 0; d < 256; d++ )
+		sort_from( a + bucket[d], bucket[d+1] - bucket[d], shift - 8 );
+}
+
+}  // namespace radix_sort
+
+#endif  // __RADIX_SORT_H_INCLUDED
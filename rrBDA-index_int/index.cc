@@ -23,6 +23,7 @@
 #include <math.h>
 #include "rrbda-index_int.h"
 #include "krfp.h"
+#include <omp.h>
 
 using namespace std;
 using namespace sdsl;
@@ -35,265 +36,169 @@ using namespace sdsl;
 #include <divsufsort.h>                                       	  // include header for suffix sort
 #endif
 
-void reverse( unsigned char * &s, INT text_size)
+/* Reads the numbers of an index of the text format of earlier versions from file_name, one per line, into V */
+void read_index_file( string file_name, vector<INT> * V )
 {
-	INT length = text_size ;
-	
-	unsigned char temp = ' ';
-	INT i = 0, j = length-1;
+	ifstream in_file( file_name, ios::binary );
+	in_file.seekg( 0, in_file.end );
+	INT file_size = in_file.tellg();
+	in_file.seekg( 0, in_file.beg );
+
+	string number = "";
+	unsigned char c = 0;
+	for (INT i = 0; i < file_size; i++)
+	{	
+		in_file.read(reinterpret_cast<char*>(&c), 1);
 	
-	while( i < j )
-	{
-		temp = s[j];
-		s[j] = s[i];
-		s[i] = temp;
-		
-		i++, j--;
+		if( (unsigned char) c == '\n' )
+		{
+			V->push_back( stol( number ) );
+			number = "";
+		}
+		else number += (unsigned char) c;
 	}
 }
- 
 
-INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsigned char * text_string, unordered_set<INT> &text_anchors, vector<INT> * RSA, vector<INT> * RLCP, vector<INT> * LSA, vector<INT> * LLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq )
+/* The number of bd-anchors of an index in the text files of earlier versions, one per line of its .RSA file, or 0 unless its four arrays are all there */
+INT legacy_anchors( string index_name )
 {
-	vector<INT> * anchors_vector = new vector<INT>();	
+	if( !utils::file_exists( index_name + ".RSA" ) || !utils::file_exists( index_name + ".RLCP" ) || !utils::file_exists( index_name + ".LSA" ) || !utils::file_exists( index_name + ".LLCP" ) )
+		return 0;
+	ifstream is_RSA( index_name + ".RSA", ios::binary );
+	return std::count( istreambuf_iterator<char>( is_RSA ), istreambuf_iterator<char>(), '\n' );
+}
 
-	unsigned char c = 0;
-	
-	/* Constructing right and left compacted tries */
-	string sa_index_name = index_name + ".RSA";
- 	
-	ifstream in_RSA(sa_index_name, ios::binary);
-	in_RSA.seekg (0, in_RSA.end);
-	INT file_size_sa = in_RSA.tellg();
-	
-	ifstream is_RSA;
- 	is_RSA.open (sa_index_name, ios::in | ios::binary);
-	
-	string lcp_index_name = index_name + ".RLCP";
-	
-	ifstream is_RLCP;
- 	is_RLCP.open (lcp_index_name, ios::in | ios::binary);
- 	
-	ifstream in_RLCP(lcp_index_name, ios::binary);
-	in_RLCP.seekg (0, in_RLCP.end);
-	INT file_size_lcp = in_RLCP.tellg();
-	
+/* Builds the compacted trie of the anchors over one direction of the text by the given strategy into SA and LCP, or loads it from the text files of earlier versions if they exist, and then the RMQ data structure over LCP; left selects the reversed direction and its file names, and mirrored tells that the anchors are still those of the text, which only the full strategy takes */
+void compacted_trie( uint64_t hash, string index_name, bool left, INT text_size, INT g, const text_view &text, vector<INT> * anchors, bool mirrored, vector<INT> * SA, vector<INT> * LCP, rmq_succinct_sct<> &rmq, build_strategy::kind strategy, INT threads, double fp_bytes, const vector<uint64_t> * chunk_fp, INT chunk_len, INT ssa_memory )
+{
+	string side = left ? "Left" : "Right";
+	string sa_index_name = index_name + ( left ? ".LSA" : ".RSA" );
+	string lcp_index_name = index_name + ( left ? ".LLCP" : ".RLCP" );
 	
-	for(auto &anchor: text_anchors)
-		anchors_vector->push_back(anchor);
-		
-	text_anchors.clear();
+	ifstream is_SA( sa_index_name, ios::in | ios::binary );
+	ifstream is_LCP( lcp_index_name, ios::in | ios::binary );
 	
-	if( !(is_RSA) || !(is_RLCP )  )
-	{
-		ssa(text_string, text_size, anchors_vector, sa_index_name, lcp_index_name, RSA, RLCP, hash );
-	 
-	} 	
-	else 
+	if( ( !(is_SA) || !(is_LCP) ) && strategy == build_strategy::FULL )
 	{
-		if( file_size_sa > 0 )
+		/* libdivsufsort sorts a text in one piece, so the reversed text is copied out of its view; the cost of the full strategy counts these n bytes */
+		vector<unsigned char> reversed;
+		if( left )
 		{
-			
-		   	string sa = "";
-		   	INT sa_int = 0;
-			c = 0;
-			
-			for (INT i = 0; i < file_size_sa; i++)
-			{	
-				is_RSA.read(reinterpret_cast<char*>(&c), 1);
-			
-				if( (unsigned char) c == '\n' )
-				{
-					sa_int = stol( sa);
-					RSA->push_back( sa_int );
-					sa = "";
-				}
-				else sa += (unsigned char) c;
-				
-			}
-			is_RSA.close();
-		
-		
+			reversed.resize( text_size );
+			for(INT i = 0; i<text_size; i++)
+				reversed[i] = text[i];
 		}
-		
-	
-		if( file_size_lcp > 0 )
-		{	
-			
-		   	string lcp = "";
-		   	INT lcp_int = 0;
-			c = 0;
-			
-			for (INT i = 0; i < file_size_lcp; i++)
-			{	
-				is_RLCP.read(reinterpret_cast<char*>(&c), 1);
-				
-				if( (unsigned char) c == '\n' )
-				{
-					lcp_int = stol(lcp);
-					RLCP->push_back(lcp_int);
-					lcp = "";
-				}
-				else lcp += (unsigned char) c;
-				
-			}
-			is_RLCP.close();
-		}
-	
-	}
-	
-	cout<<"Right Compacted trie constructed "<<endl;
-	
-  	/* We reverse the string for the left direction and also overwrite all other DSs */
-  	reverse(text_string, text_size);
-  	
-	sa_index_name = index_name + ".LSA";
-	ifstream is_LSA;
- 	is_LSA.open (sa_index_name, ios::in | ios::binary);
- 	
-	ifstream in_LSA(sa_index_name, ios::binary);
-	in_LSA.seekg (0, in_LSA.end);
-	file_size_sa = in_LSA.tellg();
-	
-	lcp_index_name = index_name +".LLCP" ;
-	
-	ifstream is_LLCP;
- 	is_LLCP.open (lcp_index_name, ios::in | ios::binary);
-	
-	ifstream in_LLCP(lcp_index_name, ios::binary);
-	in_LLCP.seekg (0, in_LLCP.end);
-	file_size_lcp = in_LLCP.tellg();
 
+		bit_vector marked( text_size, 0 );
+		for(INT i = 0; i<g; i++)
+			marked[ anchors->at(i) ] = 1;
 
-	for(INT i = 0; i<anchors_vector->size(); i++)
-	{
-		anchors_vector->at(i) = ( text_size - 1 ) - anchors_vector->at(i);
+		SA->resize( g );
+		LCP->resize( g );
+		full_sa::compacted_trie( left ? reversed.data() : text.address( 0 ), text_size, marked, mirrored, SA->data(), LCP->data() );
 	}
-	
-
-	if ( !(is_LSA) || !(is_LLCP) )
+	else if( !(is_SA) || !(is_LCP) )
 	{
-		ssa(text_string, text_size, anchors_vector, sa_index_name, lcp_index_name, LSA, LLCP, hash );
+		ssa(text, text_size, anchors, sa_index_name + ".buckets", SA, LCP, hash, threads, fp_bytes, chunk_fp, chunk_len, ssa_memory );
 	}
-	
 	else
 	{
-		if( file_size_sa  > 0 )
-		{
-		   	string sa = "";
-		   	INT sa_int = 0;
-			c = 0;
-			
-			for (INT i = 0; i < file_size_sa; i++)
-			{	
-				is_LSA.read(reinterpret_cast<char*>(&c), 1);
-				
-				if( (unsigned char) c == '\n')
-				{
-					sa_int = stol( sa);
-					LSA->push_back( sa_int );
-					sa = "";
-				}
-				else sa += (unsigned char) c;
-				
-			}
-			is_LSA.close();	
-		}
-	
-		if( file_size_lcp  > 0 )
-		{
-		   	string lcp = "";
-		   	INT lcp_int = 0;
-			c = 0;
-			
-			for (INT i = 0; i < file_size_lcp; i++)
-			{	
-				is_LLCP.read(reinterpret_cast<char*>(&c), 1);
-				
-				if( (unsigned char) c == '\n' )
-				{
-					lcp_int = stol( lcp );
-					LLCP->push_back(lcp_int);
-					lcp = "";
-				}
-				else lcp += (unsigned char) c;
-				
-			}
-			is_LLCP.close();	
-		}
+		read_index_file( sa_index_name, SA );
+		read_index_file( lcp_index_name, LCP );
 	}
 	
-	cout<<"Left Compacted trie constructed "<<endl;
+	cout<<side<<" Compacted trie constructed "<<endl;
 
-  	delete( anchors_vector );
-	/* After constructing the tries these DSs over the whole string are not needed anymore, our data structure must be of size O(g) */
-
-  	/* The following RMQ data structures are used for spelling pattern over the LSA and RSA */
-  
-	string rmq_left_suffix = index_name +".lrmq";
+  	/* The following RMQ data structure is used for spelling pattern over SA */
+	string rmq_suffix = index_name + ( left ? ".lrmq" : ".rrmq" );
   		
-	ifstream in_rmq_left(rmq_left_suffix, ios::binary);  	
+	ifstream in_rmq(rmq_suffix, ios::binary);  	
   	
-  	if( in_rmq_left )
+  	if( in_rmq )
   	{
-  	
-  		load_from_file(lrmq, rmq_left_suffix); 
+  		load_from_file(rmq, rmq_suffix); 
 	}
   	else
   	{
-	  	int_vector<> llcp( g , 0 ); // create a vector of length n and initialize it with 0s
+	  	int_vector<> lcp( g , 0 ); // create a vector of length n and initialize it with 0s
 
-		
 		for ( INT i = 0; i < g; i ++ )
 		{
-			llcp[i] = LLCP->at(i);
-			
+			lcp[i] = LCP->at(i);
 		}
 
-		util::assign(lrmq, rmq_succinct_sct<>(&llcp));
+		util::assign(rmq, rmq_succinct_sct<>(&lcp));
 		
-		util::clear(llcp);
-
-		store_to_file(lrmq, rmq_left_suffix);
+		util::clear(lcp);
 	}
 	
-	cout<<"Left RMQ DS constructed "<<endl;
-	string rmq_right_suffix = index_name+ ".rrmq";
-	
-	ifstream in_rmq_right(rmq_right_suffix, ios::binary);
-  	  
-  	int_vector<> rlcp( g , 0 ); // create a vector of length n and initialize it with 0s
-  	
-  	if( in_rmq_right )
-  	{
+	cout<<side<<" RMQ DS constructed "<<endl;
+}
 
-  		load_from_file(rrmq, rmq_right_suffix);
-  	}
-  	else
-  	{
-		int_vector<> rlcp( g , 0 ); // create a vector of length n and initialize it with 0s
+/* Turns the anchors of the text into those of the reversed text: they are mirrored and reversed so that they stay sorted */
+void mirror_anchors( vector<INT> &anchors, INT text_size )
+{
+	for( INT &a : anchors )
+		a = ( text_size - 1 ) - a;
+	std::reverse( anchors.begin(), anchors.end() );
+}
 
-		for ( INT i = 0; i < g; i ++ )
+INT compute_index( uint64_t hash, string index_name, INT text_size, INT g, unsigned char * text_string, vector<INT> &text_anchors, vector<INT> * RSA, vector<INT> * RLCP, vector<INT> * LSA, vector<INT> * LLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, INT threads, double fp_bytes, const chunk_hashes * chunks, INT ssa_memory, build_strategy::kind strategy )
+{
+	/* Constructing right and left compacted tries, the left ones over the reversed view of the text */
+	text_view right_text( text_string, text_size, false );
+	text_view left_text( text_string, text_size, true );
+
+	/* The strategy is chosen for both directions, within the memory ssa() takes under its budget */
+	if( !utils::file_exists( index_name + ".RSA" ) || !utils::file_exists( index_name + ".RLCP" ) || !utils::file_exists( index_name + ".LSA" ) || !utils::file_exists( index_name + ".LLCP" ) )
+	{
+		INT chunk_bytes = ( chunks != NULL ) ? chunk_hashes::bytes( text_size, fp_bytes ) : 0;
+		build_strategy::input in = { text_size, g, threads, build_strategy::available_memory(), fp_bytes, ( double ) ( ssa_memory > 0 ? ssa_memory - chunk_bytes : 0 ), 2.0 * chunk_bytes, 0, true, false, false };
+		if( ssa_memory > 0 )
+			in.memory = std::min( in.memory, build_strategy::cost( build_strategy::SPARSE, in ).bytes );
+		cout<<"Estimates for building the compacted tries, with "<<in.memory / ( 1024.0 * 1024.0 )<<" MB available:"<<endl;
+		strategy = build_strategy::choose( in, strategy );
+		cout<<"The compacted tries are built by the "<<build_strategy::name( strategy )<<" strategy"<<endl;
+
+		/* The chunks computed with the bd-anchors count under the budget of ssa() */
+		if( strategy == build_strategy::SPARSE && ssa_memory > 0 )
+			ssa_memory -= chunk_bytes;
+	}
+
+	/* With two threads or more, the two directions are built at the same time by half of the threads each; the left one copies the anchors only for the sparse strategy, as ssa() extends its list */
+	if( threads > 1 )
+	{
+		vector<INT> * left_anchors = NULL;
+		if( strategy == build_strategy::SPARSE )
 		{
-			rlcp[i] = RLCP->at(i);
+			left_anchors = new vector<INT>( text_anchors );
+			mirror_anchors( *left_anchors, text_size );
 		}
-		
-		util::assign(rrmq, rmq_succinct_sct<>(&rlcp));
-		
-		util::clear(rlcp);
-		 
-	  	
-	  	
-	  	store_to_file(rrmq, rmq_right_suffix);
-	}	
-	 
-	cout<<"Right RMQ DS constructed "<<endl;
+
+		if( omp_get_max_active_levels() < 2 )
+			omp_set_max_active_levels( 2 );
+
+		#pragma omp parallel sections num_threads( 2 )
+		{
+			#pragma omp section
+			compacted_trie( hash, index_name, false, text_size, g, right_text, &text_anchors, false, RSA, RLCP, rrmq, strategy, ( threads + 1 ) / 2, fp_bytes, chunks == NULL ? NULL : &chunks->forward, chunks == NULL ? 0 : chunks->len, ssa_memory );
+			
+			#pragma omp section
+			compacted_trie( hash, index_name, true, text_size, g, left_text, left_anchors == NULL ? &text_anchors : left_anchors, left_anchors == NULL, LSA, LLCP, lrmq, strategy, threads / 2, fp_bytes, chunks == NULL ? NULL : &chunks->reverse, chunks == NULL ? 0 : chunks->len, ssa_memory );
+		}
+		delete( left_anchors );
+	}
+	else
+	{
+		compacted_trie( hash, index_name, false, text_size, g, right_text, &text_anchors, false, RSA, RLCP, rrmq, strategy, threads, fp_bytes, chunks == NULL ? NULL : &chunks->forward, chunks == NULL ? 0 : chunks->len, ssa_memory );
+		mirror_anchors( text_anchors, text_size );
+		compacted_trie( hash, index_name, true, text_size, g, left_text, &text_anchors, false, LSA, LLCP, lrmq, strategy, threads, fp_bytes, chunks == NULL ? NULL : &chunks->reverse, chunks == NULL ? 0 : chunks->len, ssa_memory );
+	}
+
+	/* After constructing the tries these DSs over the whole string are not needed anymore, our data structure must be of size O(g) */
+  	vector<INT>().swap( text_anchors );
+	
   	cout<<"The whole index is constructed"<<endl;
-  	
-  	reverse( text_string, text_size );
-  	
-  	
 
 	return 0;
-	
-}	
+}
@@ -38,12 +38,14 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <cstdint>
 #include <vector>
 #include <algorithm>
 #include <string>
 #include <iostream>
 #include <random>
+#include <immintrin.h>
 #include "utils_krfp.h"
 #include "krfp.h"
 
@@ -179,6 +181,327 @@ std::uint64_t subtract_fast(
     (long_hash - tmp) :
     ((long_hash + p) - tmp);
 }
+//=============================================================================
+// Rolling Karp-Rabin fingerprints of all k-length substrings of seq[0..n).
+// On return FP[j] = hash(seq[j..j+k)) for j = 0, .., n - k, exactly as if
+// they were computed one after the other with concat and subtract_fast.
+// base is the Karp-Rabin base and power must be base^k mod p.
+//
+// The serial recurrence carries a dependency from every fingerprint to the
+// next one. The kernels below split the positions into independent lanes
+// (contiguous runs of positions), start each lane with a fingerprint
+// computed from scratch, and advance all lanes at once. The contribution
+// c * power of the outgoing symbol is taken from a 256-entry table.
+//=============================================================================
+namespace {
+
+const std::uint64_t mersenne_61 = ((std::uint64_t)1 << 61) - 1;
+
+// Fingerprint of seq[j..j+k) from scratch.
+inline std::uint64_t lane_start(
+    const unsigned char * seq,
+    const std::uint64_t j,
+    const std::uint64_t k,
+    const std::uint64_t base) {
+  std::uint64_t fp = 0;
+  for (std::uint64_t i = j; i < j + k; ++i)
+    fp = mod_mersenne(mul_mod_mersenne(fp, base, 61) + seq[i], 61);
+  return fp;
+}
+
+// One step of the recurrence, with out = (c_out * power) mod p.
+inline std::uint64_t lane_step(
+    const std::uint64_t fp,
+    const unsigned char c_in,
+    const std::uint64_t out,
+    const std::uint64_t base) {
+  const std::uint64_t h = mod_mersenne(
+      mul_mod_mersenne(fp, base, 61) + c_in, 61);
+  return (h >= out) ? (h - out) : ((h + mersenne_61) - out);
+}
+
+// Advance FP serially from position `from` (whose fingerprint is already
+// stored) up to position `to` inclusive.
+inline void serial_steps(
+    const unsigned char * seq,
+    const std::uint64_t from,
+    const std::uint64_t to,
+    const std::uint64_t k,
+    const std::uint64_t base,
+    const std::uint64_t * out,
+    std::uint64_t * FP) {
+  std::uint64_t fp = FP[from];
+  for (std::uint64_t j = from + 1; j <= to; ++j) {
+    fp = lane_step(fp, seq[j + k - 1], out[seq[j - 1]], base);
+    FP[j] = fp;
+  }
+}
+
+//=============================================================================
+// (a * b) mod p for the 61-bit Mersenne prime on 64-bit vector lanes, built
+// from 32x32->64-bit multiplies. a and b must be smaller than p. With
+// a = a1.2^32 + a0 and b = b1.2^32 + b0, and since 2^61 = 1 (mod p):
+//   a0.b0         = (a0.b0 & p) + (a0.b0 >> 61)
+//   mid.2^32      = (mid >> 29) + ((mid & (2^29 - 1)) << 32)
+//   a1.b1.2^64    = 8.a1.b1
+// where mid = a1.b0 + a0.b1. The sum is below 2^63 and is folded twice.
+//=============================================================================
+__attribute__((target("avx2")))
+inline __m256i mul_mod_mersenne_avx2(const __m256i a, const __m256i b) {
+  const __m256i p = _mm256_set1_epi64x(mersenne_61);
+  const __m256i m29 = _mm256_set1_epi64x(((std::uint64_t)1 << 29) - 1);
+  const __m256i a1 = _mm256_srli_epi64(a, 32);
+  const __m256i b1 = _mm256_srli_epi64(b, 32);
+  const __m256i lo = _mm256_mul_epu32(a, b);
+  const __m256i mid = _mm256_add_epi64(
+      _mm256_mul_epu32(a1, b), _mm256_mul_epu32(a, b1));
+  const __m256i hi = _mm256_mul_epu32(a1, b1);
+  __m256i x = _mm256_add_epi64(
+      _mm256_and_si256(lo, p), _mm256_srli_epi64(lo, 61));
+  x = _mm256_add_epi64(x, _mm256_srli_epi64(mid, 29));
+  x = _mm256_add_epi64(x, _mm256_slli_epi64(_mm256_and_si256(mid, m29), 32));
+  x = _mm256_add_epi64(x, _mm256_slli_epi64(hi, 3));
+  x = _mm256_add_epi64(_mm256_and_si256(x, p), _mm256_srli_epi64(x, 61));
+  x = _mm256_add_epi64(_mm256_and_si256(x, p), _mm256_srli_epi64(x, 61));
+  return x;
+}
+
+// x - p if x >= p, for x < 2^62.
+__attribute__((target("avx2")))
+inline __m256i canonical_avx2(const __m256i x) {
+  const __m256i p = _mm256_set1_epi64x(mersenne_61);
+  const __m256i ge = _mm256_cmpgt_epi64(x, _mm256_set1_epi64x(mersenne_61 - 1));
+  return _mm256_sub_epi64(x, _mm256_and_si256(ge, p));
+}
+
+// The AVX-512 code uses the zero-masking forms of the intrinsics on all
+// eight lanes: the unmasked forms pass an uninitialized vector through,
+// which GCC 12 warns about under -Wall.
+const __mmask8 all_lanes = 0xFF;
+
+__attribute__((target("avx512f")))
+inline __m512i mul_mod_mersenne_avx512(const __m512i a, const __m512i b) {
+  const __m512i p = _mm512_set1_epi64(mersenne_61);
+  const __m512i m29 = _mm512_set1_epi64(((std::uint64_t)1 << 29) - 1);
+  const __m512i a1 = _mm512_maskz_srli_epi64(all_lanes, a, 32);
+  const __m512i b1 = _mm512_maskz_srli_epi64(all_lanes, b, 32);
+  const __m512i lo = _mm512_maskz_mul_epu32(all_lanes, a, b);
+  const __m512i mid = _mm512_add_epi64(
+      _mm512_maskz_mul_epu32(all_lanes, a1, b),
+      _mm512_maskz_mul_epu32(all_lanes, a, b1));
+  const __m512i hi = _mm512_maskz_mul_epu32(all_lanes, a1, b1);
+  __m512i x = _mm512_add_epi64(
+      _mm512_and_si512(lo, p), _mm512_maskz_srli_epi64(all_lanes, lo, 61));
+  x = _mm512_add_epi64(x, _mm512_maskz_srli_epi64(all_lanes, mid, 29));
+  x = _mm512_add_epi64(x, _mm512_maskz_slli_epi64(all_lanes,
+      _mm512_and_si512(mid, m29), 32));
+  x = _mm512_add_epi64(x, _mm512_maskz_slli_epi64(all_lanes, hi, 3));
+  x = _mm512_add_epi64(_mm512_and_si512(x, p),
+      _mm512_maskz_srli_epi64(all_lanes, x, 61));
+  x = _mm512_add_epi64(_mm512_and_si512(x, p),
+      _mm512_maskz_srli_epi64(all_lanes, x, 61));
+  return x;
+}
+
+__attribute__((target("avx512f")))
+inline __m512i canonical_avx512(const __m512i x) {
+  const __m512i p = _mm512_set1_epi64(mersenne_61);
+  const __mmask8 ge = _mm512_cmpge_epu64_mask(x, p);
+  return _mm512_mask_sub_epi64(x, ge, x, p);
+}
+
+// (c * power) mod p for symbols c < 2^8 and power < p: c.power is split at
+// bit 32 of power, and (c.ph).2^32 is folded as mid.2^32 above.
+__attribute__((target("avx512f")))
+inline __m512i mul_symbol_avx512(const __m512i c, const __m512i power) {
+  const __m512i p = _mm512_set1_epi64(mersenne_61);
+  const __m512i m29 = _mm512_set1_epi64(((std::uint64_t)1 << 29) - 1);
+  const __m512i lo = _mm512_maskz_mul_epu32(all_lanes, c, power);
+  const __m512i hi = _mm512_maskz_mul_epu32(all_lanes, c,
+      _mm512_maskz_srli_epi64(all_lanes, power, 32));
+  __m512i x = _mm512_add_epi64(lo, _mm512_maskz_srli_epi64(all_lanes, hi, 29));
+  x = _mm512_add_epi64(x, _mm512_maskz_slli_epi64(all_lanes,
+      _mm512_and_si512(hi, m29), 32));
+  x = _mm512_add_epi64(_mm512_and_si512(x, p),
+      _mm512_maskz_srli_epi64(all_lanes, x, 61));
+  return canonical_avx512(x);
+}
+
+// Transposes the 8x8 matrix of the rows r[0..8) in place.
+__attribute__((target("avx512f")))
+inline void transpose_avx512(__m512i * r) {
+  __m512i t[8], u[8];
+  for (int i = 0; i < 8; i += 2) {
+    t[i] = _mm512_maskz_unpacklo_epi64(all_lanes, r[i], r[i + 1]);
+    t[i + 1] = _mm512_maskz_unpackhi_epi64(all_lanes, r[i], r[i + 1]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    u[i] = _mm512_maskz_shuffle_i64x2(all_lanes, t[i], t[i + 2],
+        _MM_SHUFFLE(2, 0, 2, 0));
+    u[i + 2] = _mm512_maskz_shuffle_i64x2(all_lanes, t[i], t[i + 2],
+        _MM_SHUFFLE(3, 1, 3, 1));
+    u[i + 4] = _mm512_maskz_shuffle_i64x2(all_lanes, t[i + 4], t[i + 6],
+        _MM_SHUFFLE(2, 0, 2, 0));
+    u[i + 6] = _mm512_maskz_shuffle_i64x2(all_lanes, t[i + 4], t[i + 6],
+        _MM_SHUFFLE(3, 1, 3, 1));
+  }
+  for (int i = 0; i < 4; ++i) {
+    r[i] = _mm512_maskz_shuffle_i64x2(all_lanes, u[i], u[i + 4],
+        _MM_SHUFFLE(2, 0, 2, 0));
+    r[i + 4] = _mm512_maskz_shuffle_i64x2(all_lanes, u[i], u[i + 4],
+        _MM_SHUFFLE(3, 1, 3, 1));
+  }
+}
+
+}  // namespace
+
+void fingerprints_scalar(
+    const unsigned char * seq,
+    const std::uint64_t n,
+    const std::uint64_t k,
+    const std::uint64_t base,
+    const std::uint64_t power,
+    std::uint64_t * FP) {
+  std::uint64_t out[256];
+  for (std::uint64_t c = 0; c < 256; ++c)
+    out[c] = mul_mod_mersenne(c, power, 61);
+
+  FP[0] = lane_start(seq, 0, k, base);
+  serial_steps(seq, 0, n - k, k, base, out, FP);
+}
+
+__attribute__((target("avx2")))
+void fingerprints_avx2(
+    const unsigned char * seq,
+    const std::uint64_t n,
+    const std::uint64_t k,
+    const std::uint64_t base,
+    const std::uint64_t power,
+    std::uint64_t * FP) {
+  const std::uint64_t lanes = 4;
+  const std::uint64_t m = n - k + 1;
+  const std::uint64_t len = m / lanes;
+  if (len < 2 * k) {
+    fingerprints_scalar(seq, n, k, base, power, FP);
+    return;
+  }
+
+  std::uint64_t out[256];
+  for (std::uint64_t c = 0; c < 256; ++c)
+    out[c] = mul_mod_mersenne(c, power, 61);
+
+  // Lane l covers positions [l.len, (l+1).len); the tail is done serially.
+  std::uint64_t start[lanes];
+  for (std::uint64_t l = 0; l < lanes; ++l) {
+    start[l] = l * len;
+    FP[start[l]] = lane_start(seq, start[l], k, base);
+  }
+
+  const __m256i p = _mm256_set1_epi64x(mersenne_61);
+  const __m256i vbase = _mm256_set1_epi64x(base);
+  __m256i fp = _mm256_set_epi64x(FP[start[3]], FP[start[2]],
+      FP[start[1]], FP[start[0]]);
+  for (std::uint64_t i = 1; i < len; ++i) {
+    const std::uint64_t j0 = start[0] + i, j1 = start[1] + i;
+    const std::uint64_t j2 = start[2] + i, j3 = start[3] + i;
+    const __m256i c_in = _mm256_set_epi64x(seq[j3 + k - 1],
+        seq[j2 + k - 1], seq[j1 + k - 1], seq[j0 + k - 1]);
+    const __m256i c_out = _mm256_set_epi64x(out[seq[j3 - 1]],
+        out[seq[j2 - 1]], out[seq[j1 - 1]], out[seq[j0 - 1]]);
+    __m256i h = canonical_avx2(_mm256_add_epi64(
+        mul_mod_mersenne_avx2(fp, vbase), c_in));
+    fp = canonical_avx2(_mm256_sub_epi64(_mm256_add_epi64(h, p), c_out));
+
+    alignas(32) std::uint64_t v[lanes];
+    _mm256_store_si256((__m256i *)v, fp);
+    FP[j0] = v[0]; FP[j1] = v[1]; FP[j2] = v[2]; FP[j3] = v[3];
+  }
+  serial_steps(seq, lanes * len - 1, m - 1, k, base, out, FP);
+}
+
+__attribute__((target("avx512f")))
+void fingerprints_avx512(
+    const unsigned char * seq,
+    const std::uint64_t n,
+    const std::uint64_t k,
+    const std::uint64_t base,
+    const std::uint64_t power,
+    std::uint64_t * FP) {
+  const std::uint64_t lanes = 8;
+  const std::uint64_t m = n - k + 1;
+  const std::uint64_t len = m / lanes;
+  if (len < 2 * k) {
+    fingerprints_scalar(seq, n, k, base, power, FP);
+    return;
+  }
+
+  std::uint64_t out[256];
+  for (std::uint64_t c = 0; c < 256; ++c)
+    out[c] = mul_mod_mersenne(c, power, 61);
+
+  // Lane l covers positions [l.len, (l+1).len); the tail is done serially.
+  std::uint64_t start[lanes];
+  for (std::uint64_t l = 0; l < lanes; ++l) {
+    start[l] = l * len;
+    FP[start[l]] = lane_start(seq, start[l], k, base);
+  }
+
+  // Every lane reads the 8 symbols entering and the 8 leaving its next 8
+  // windows with one 8-byte load each, and stores their fingerprints with
+  // one 64-byte store once the 8 steps are transposed.
+  const __m512i p = _mm512_set1_epi64(mersenne_61);
+  const __m512i byte = _mm512_set1_epi64(0xFF);
+  const __m512i vbase = _mm512_set1_epi64(base);
+  const __m512i vpower = _mm512_set1_epi64(power);
+  __m512i fp = _mm512_set_epi64(FP[start[7]], FP[start[6]], FP[start[5]],
+      FP[start[4]], FP[start[3]], FP[start[2]], FP[start[1]], FP[start[0]]);
+  std::uint64_t i = 1;
+  for (; i + 8 <= len; i += 8) {
+    alignas(64) std::uint64_t w_in[lanes], w_out[lanes];
+    for (std::uint64_t l = 0; l < lanes; ++l) {
+      std::memcpy(&w_in[l], seq + start[l] + i + k - 1, 8);
+      std::memcpy(&w_out[l], seq + start[l] + i - 1, 8);
+    }
+    const __m512i words_in = _mm512_load_si512((const void *)w_in);
+    const __m512i words_out = _mm512_load_si512((const void *)w_out);
+
+    __m512i steps[8];
+    for (int t = 0; t < 8; ++t) {
+      const __m512i c_in = _mm512_and_si512(
+          _mm512_maskz_srli_epi64(all_lanes, words_in, 8 * t), byte);
+      const __m512i c_out = mul_symbol_avx512(_mm512_and_si512(
+          _mm512_maskz_srli_epi64(all_lanes, words_out, 8 * t), byte), vpower);
+      const __m512i h = canonical_avx512(_mm512_add_epi64(
+          mul_mod_mersenne_avx512(fp, vbase), c_in));
+      fp = canonical_avx512(_mm512_sub_epi64(_mm512_add_epi64(h, p), c_out));
+      steps[t] = fp;
+    }
+
+    transpose_avx512(steps);
+    for (std::uint64_t l = 0; l < lanes; ++l)
+      _mm512_storeu_si512((void *)(FP + start[l] + i), steps[l]);
+  }
+
+  // The last steps of every lane, fewer than 8, are done serially.
+  for (std::uint64_t l = 0; l < lanes; ++l)
+    serial_steps(seq, start[l] + i - 1, start[l] + len - 1, k, base, out, FP);
+  serial_steps(seq, lanes * len - 1, m - 1, k, base, out, FP);
+}
+
+void fingerprints(
+    const unsigned char * seq,
+    const std::uint64_t n,
+    const std::uint64_t k,
+    const std::uint64_t base,
+    const std::uint64_t power,
+    std::uint64_t * FP) {
+  static const int isa = __builtin_cpu_supports("avx512f") ? 2 :
+    (__builtin_cpu_supports("avx2") ? 1 : 0);
+  if (isa == 2) fingerprints_avx512(seq, n, k, base, power, FP);
+  else if (isa == 1) fingerprints_avx2(seq, n, k, base, power, FP);
+  else fingerprints_scalar(seq, n, k, base, power, FP);
+}
+
 //=============================================================================
 // Initialize the base and exponent for Karp-Rabin hashing.
 //=============================================================================
@@ -187,5 +510,15 @@ std::uint64_t init() {
   hash_variable = rand_mod_mersenne(mersenne_prime_exponent);
   return hash_variable;
 }
+
+//=============================================================================
+// Initialize Karp-Rabin hashing with a given base, e.g. one stored with an
+// index.
+//=============================================================================
+std::uint64_t init(const std::uint64_t base) {
+  mersenne_prime_exponent = 61; //do not change this
+  hash_variable = base;
+  return hash_variable;
+}
 }
 
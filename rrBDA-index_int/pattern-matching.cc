@@ -23,131 +23,34 @@
 #include <math.h>
 #include "rrbda-index_int.h"
 #include "krfp.h"
+#include "rotation.h"
+#include "min_queue.h"
+#include "anchor_hash.h"
 
 using namespace std;
 using namespace sdsl;
 
-INT red_minlexrot( unsigned char * X, INT n, uint64_t k, uint64_t power )
+/* Computes the reduced bd-anchor of a window X of length n; draws must have room for n-k+1 positions and FP for n-k+1 fingerprints, both are reused from one call to the next */
+INT red_minlexrot( unsigned char * X, INT n, uint64_t k, const anchor_hash::policy &hash_policy, min_queue &draws, uint64_t * FP )
 {  
-  	uint64_t fp = 0;
-    	vector<INT> * draws = new vector<INT>();
-	
-	for(uint64_t j = 0; j<k; j++)
-        	fp =  karp_rabin_hashing::concat( fp, X[j] , 1 );
+	/* A window shorter than a k-mer has no draw, so its anchor is its first position */
+	if( n < ( INT ) k )
+		return 0;
 
-	draws->push_back(0);
-	uint64_t smallest_fp = fp;
-  	INT smallest_fp_pos = 0;
-  	
-  	for(INT j = 1; j<=n-k; j++)
-        {
-                fp = karp_rabin_hashing::concat( fp,  X[j+k-1] , 1 );
-                fp = karp_rabin_hashing::subtract_fast( fp, X[j-1] , power );
+	hash_policy.fingerprints( X, n, FP );
 
-                if( fp < smallest_fp )
-                {
-                	draws->clear();
-                	
-                	smallest_fp = fp;
-                	smallest_fp_pos = j;
-                	
-                	draws->push_back( j );
-                
-                }
-                else if( fp == smallest_fp )
-                {	
-                	draws->push_back( j );
-                }	
-                
-       
-        }
-
- 	if( draws->size() > 1 )
-        {
-        	smallest_fp = draws->at(0);
-        	
-       		for(INT i = 1; i<draws->size(); i++ )
-		{
-			INT a_pos = smallest_fp_pos+k;
-			INT b_pos = draws->at(i)+k;
-				
-			bool cont = false;
-			for(INT j = k; j<n; j++)
-			{
-				unsigned char a = X[a_pos];
-				unsigned char b = X[b_pos];
-						
-				if( b_pos >= n )
-				{
-					b_pos = 0;
-					cont = true;
-					break;
-				}
-					
-				if( b < a )
-				{
-					smallest_fp_pos =  draws->at(i);
-					break;
-				}
-				else if( b > a )
-					break;
-				
-				a_pos++;
-				b_pos++;
-	  
-			}
-				
-			if( cont == true )
-			{
-				cont  = false;
-				for(INT j = 0; j<n; j++)
-				{
-		      			unsigned char a = X[a_pos];
-					unsigned char b = X[b_pos];
-							
-					if( a_pos >= n )
-					{
-						a_pos = 0;
-						cont = true;
-						break;
-					}
-					
-					if(  b < a )
-					{
-						smallest_fp_pos =  draws->at(i);
-						break;
-					}
-					else if( b > a )
-						break;
-					
-					a_pos++;
-					b_pos++;
-				}
-			}
-				
-				
-			if( cont == true )
-			{
-				for(INT j = 0; j<n; j++)
-				{
-		      			unsigned char a = X[a_pos];
-					unsigned char b = X[b_pos];
-							
-					if( b_pos >= n || b < a )
-					{
-						smallest_fp_pos =  draws->at(i);
-						break;
-					}
-					else if ( b > a )
-						break;
-					a_pos++;
-					b_pos++;
-				}
-			}	
-		}	
-        
-        }
-        delete( draws );
+	draws.clear();
+  	for(INT j = 0; j<=n-( INT ) k; j++)
+                draws.push( FP[j], j );
+
+	/* A later draw wins when the rotation of X starting right after its k-mer is not larger than that of the current one */
+  	INT smallest_fp_pos = draws.tie_pos(0);
+	for(INT i = 1; i<draws.tie_count(); i++ )
+	{
+		if( rotation::compare( X, n, ( draws.tie_pos(i) + k ) % n, ( smallest_fp_pos + k ) % n ) <= 0 )
+			smallest_fp_pos = draws.tie_pos(i);
+	}
+	
    	return smallest_fp_pos;
 }
 
@@ -199,7 +102,7 @@ INT lcp ( unsigned char *  x, INT M, unsigned char * y, INT l, INT a_size, INT w
 }
 
 /* Searching a list of strings using LCP from "Algorithms on Strings" by Crochemore et al. Algorithm takes O(m + log n), where n is the list size and m the length of pattern */
-pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<INT> * SA, vector<INT> * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size )
+pair<INT,INT> pattern_matching ( unsigned char *  w, unsigned char *  a, const INT * SA, const INT * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size )
 {
 
 	INT m = w_size; //length of pattern
@@ -221,14 +124,14 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 		
 		if( f == n )
 			lcpif = 0;
-		else lcpif = LCP->at(rmq ( i + 1, f ) );
+		else lcpif = LCP[rmq ( i + 1, f ) ];
 			
 		/* lcp(d,i) */
 		INT lcpdi;
 		
 		if( i == n )
 			lcpdi = 0;
-		else lcpdi = LCP->at(rmq ( d + 1, i ) );
+		else lcpdi = LCP[rmq ( d + 1, i ) ];
 	
 		if ( ( ld <= lcpif ) && ( lcpif < lf ) )
 		{
@@ -245,7 +148,7 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 		else
 		{
 			INT l = std::max (ld, lf);
-			l = l + lcp ( a, SA->at( i ) + l, w, l, a_size, w_size );
+			l = l + lcp ( a, SA[i] + l, w, l, a_size, w_size );
 			if ( l == m ) //lower bound is found, let's find the upper bound
 		        {
 				INT e = i;
@@ -258,7 +161,7 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 				
 					if( e == n )
 						lcpje = 0;
-					else lcpje = LCP->at( rmq ( j + 1, e ) );
+					else lcpje = LCP[rmq ( j + 1, e ) ];
 					
 					if ( lcpje < m ) 	d = j;
 					else 			e = j;
@@ -269,7 +172,7 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 				
 				if( e == n )
 					lcpde = 0;
-				else lcpde = LCP->at( rmq ( d + 1, e ) );
+				else lcpde = LCP[rmq ( d + 1, e ) ];
 				
 				if ( lcpde >= m )	d = std::max (d-1,( INT ) -1 );
 
@@ -283,7 +186,7 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 					
 					if( j == n )
 						lcpej = 0;
-					else lcpej = LCP->at( rmq ( e + 1, j ) );
+					else lcpej = LCP[rmq ( e + 1, j ) ];
 					
 					if ( lcpej < m ) 	f = j;
 					else 			e = j;
@@ -294,7 +197,7 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 				
 				if( f == n )
 					lcpef = 0;
-				else lcpef = LCP->at(rmq ( e + 1, f ) );
+				else lcpef = LCP[rmq ( e + 1, f ) ];
 				
 				if ( lcpef >= m )	f = std::min (f+1,n);
 
@@ -304,7 +207,7 @@ pair<INT,INT> pattern_matching ( unsigned char * w, unsigned char * a, vector<IN
 
 
 			}
-			else if ( ( l == N - SA->at( i ) ) || ( ( SA->at( i ) + l < N ) && ( l != m ) && ( a[SA->at( i )+l] < w[l] ) ) )
+			else if ( ( l == N - SA[i] ) || ( ( SA[i] + l < N ) && ( l != m ) && ( a[SA[i]+l] < w[l] ) ) )
 			{
 				d = i;
 				ld = l;
@@ -340,7 +243,8 @@ INT lcs ( unsigned char *  x, INT M, unsigned char *  y, INT l, INT m )
 }
 
 
-pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vector<INT> * SA, vector<INT> * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size )
+/* Searching a list of strings using LCP from "Algorithms on Strings" by Crochemore et al. Algorithm takes O(m + log n), where n is the list size and m the length of pattern */
+pair<INT,INT> rev_pattern_matching ( unsigned char *  w, unsigned char *  a, const INT * SA, const INT * LCP, rmq_succinct_sct<> &rmq, INT n, INT w_size, INT a_size )
 {
 	
 	
@@ -356,7 +260,7 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 	while ( d + 1 < f )
 	{
 		INT i = (d + f)/2;
-		INT revSA = N - 1 - SA->at(i);
+		INT revSA = N - 1 - SA[i];
 		//std::unordered_map<pair<INT,INT>, INT, boost::hash<pair<INT,INT> >>::iterator it;
 
 		/* lcp(i,f) */
@@ -364,7 +268,7 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 		
 		if( f == n )
 			lcpif = 0;
-		else lcpif = LCP->at( rmq ( i + 1, f ) );
+		else lcpif = LCP[rmq ( i + 1, f ) ];
 		
 		/* lcp(d,i) */
 		INT lcpdi;
@@ -372,7 +276,7 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 		
 		if( i == n )
 			lcpdi = 0;
-		else lcpdi = LCP->at( rmq ( d + 1, i ) );
+		else lcpdi = LCP[rmq ( d + 1, i ) ];
 		
 	
 		if ( ( ld <= lcpif ) && ( lcpif < lf ) )
@@ -403,10 +307,9 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 					/* lcp(j,e) */
 					INT lcpje;
 					
-					
 					if( e == n )
 						lcpje = 0;
-					else lcpje = LCP->at( rmq ( j + 1, e ) );
+					else lcpje = LCP[rmq ( j + 1, e ) ];
 					
 					if ( lcpje < m ) 	d = j;
 					else 			e = j;
@@ -418,7 +321,7 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 				
 				if( e == n )
 					lcpde = 0;
-				else lcpde = LCP->at( rmq ( d + 1, e ) );
+				else lcpde = LCP[rmq ( d + 1, e ) ];
 				
 				if ( lcpde >= m )	d = std::max (d-1,( INT ) -1 );
 			
@@ -433,7 +336,7 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 					
 					if( j == n )
 						lcpej = 0;
-					else lcpej = LCP->at( rmq ( e + 1, j ) );
+					else lcpej = LCP[rmq ( e + 1, j ) ];
 					
 					if ( lcpej < m ) 	f = j;
 					else 			e = j;
@@ -441,10 +344,10 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 
 				/* lcp(e,f) */
 				INT lcpef;
-					
+				
 				if( f == n )
 					lcpef = 0;
-				else lcpef = LCP->at( rmq ( e + 1, f ) );
+				else lcpef = LCP[rmq ( e + 1, f ) ];
 				
 				if ( lcpef >= m )	f = std::min (f+1,n);
 
@@ -454,7 +357,7 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 
 
 			}
-			else if ( ( l == N - SA->at(i) ) || ( ( revSA - l >= 0 ) && ( l != m ) && ( a[revSA - l] < w[l] ) ) )
+			else if ( ( l == N - SA[i] ) || ( ( revSA - l >= 0 ) && ( l != m ) && ( a[revSA - l] < w[l] ) ) )
 			{
 				d = i;
 				ld = l;
@@ -476,7 +379,8 @@ pair<INT,INT> rev_pattern_matching (unsigned char *  w, unsigned char *  a, vect
 }
 
 
-INT query(char * arg3, unsigned char * text_string, string output_filename, INT text_size, vector<INT> * LSA, vector<INT> * LLCP, vector<INT> * RSA, vector<INT> * RLCP, rmq_succinct_sct<> &lrmq, rmq_succinct_sct<> &rrmq, INT g, INT ell, INT power, INT k )
+/* Searches for the patterns of arg3; each pattern is searched for in the level of largest order ell not exceeding its length, which has the fewest anchors and so the smallest intervals. levels must be sorted by increasing ell */
+INT query(char * arg3, unsigned char * text_string, string output_filename, INT text_size, vector<index_level> &levels, const anchor_hash::policy &hash_policy, INT k )
 {
 	INT num_seqs = 0;           // the total number of patterns considered
 	INT max_len_pattern = 0;
@@ -529,7 +433,9 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
 	} 
 	is_patterns.close();
 	
-	INT *f = new INT[ell<<1];
+	INT max_ell = levels.back().ell;
+	min_queue draws( max_ell - k + 1 );
+	uint64_t * window_fp = ( uint64_t * ) malloc( ( max_ell - k + 1 ) * sizeof( uint64_t ) );
   	ofstream pattern_output;
 	pattern_output.open(output_filename);
 	
@@ -542,16 +448,23 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
    	{
  		INT pattern_size = strlen( (char*) patterns[i] );
    	
-  		if ( pattern_size < ell )
+  		if ( pattern_size < levels.front().ell )
   		{
   			pattern_output<< patterns[i] << " skipped: its length is less than ell!\n";
   			continue;
   		}
+  		
+  		INT level = levels.size() - 1;
+  		while ( levels[level].ell > pattern_size )
+  			level--;
+  		
+  		INT ell = levels[level].ell;
+  		INT g = levels[level].g;
 		
 		memcpy( &first_window[0], &patterns[i][0], ell );
 		first_window[ell] = '\0';
 		
-  		INT j = red_minlexrot( first_window, ell, k, power );
+  		INT j = red_minlexrot( first_window, ell, k, hash_policy, draws, window_fp );
   		
 		if ( pattern_size - j >= j ) //if the right part is bigger than the left part, then search the right part to get a smaller interval on RSA (on average)
 		{ 
@@ -560,7 +473,7 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
 			memcpy( &right_pattern[0], &patterns[i][j], pattern_size-j );
 			right_pattern[pattern_size - j] = '\0';
 			
-			pair<INT,INT> right_interval = pattern_matching ( right_pattern, text_string, RSA, RLCP, rrmq, g, right_pattern_size, text_size );
+			pair<INT,INT> right_interval = pattern_matching ( right_pattern, text_string, levels[level].RSA, levels[level].RLCP, levels[level].rrmq, g, right_pattern_size, text_size );
   												
 
 			if(right_interval.first > right_interval.second)
@@ -571,7 +484,7 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
 		
 			for(INT t = right_interval.first; t <= right_interval.second; t++ ) //this can be a large interval and only one occurrence is valid.
 			{
-				INT index = RSA->at(t);
+				INT index = levels[level].RSA[t];
 				INT jj = j;		//this is the index of the anchor in the pattern
 				index--; 	jj--;	//jump the index of the anchor and start looking on the left
 				while ( ( jj >= 0 ) && ( index >= 0 ) && ( text_string[index] == patterns[i][jj] ) )
@@ -597,7 +510,7 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
 			left_pattern[j+1] = '\0';
 			
 			
-			pair<INT,INT> left_interval = rev_pattern_matching ( left_pattern, text_string, LSA, LLCP, lrmq, g, left_pattern_size, text_size );
+			pair<INT,INT> left_interval = rev_pattern_matching ( left_pattern, text_string, levels[level].LSA, levels[level].LLCP, levels[level].lrmq, g, left_pattern_size, text_size );
   														
 			if(left_interval.first > left_interval.second)	
 			{
@@ -606,7 +519,7 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
 			}
 			for(INT t = left_interval.first; t <= left_interval.second; t++ ) //this can be a large interval and only one occurrence is valid.
 			{
-				INT index = text_size-1-LSA->at(t);
+				INT index = text_size-1-levels[level].LSA[t];
 				INT jj = j;		//this is the index of the anchor in the pattern
 				index++; 	jj++;	//jump the index of the anchor and start looking on the right
 				while ( ( jj < pattern_size ) && ( index < text_size ) && ( text_string[index] == patterns[i][jj] ) )
@@ -635,7 +548,7 @@ INT query(char * arg3, unsigned char * text_string, string output_filename, INT
    	free( left_pattern );
   	free( first_window );
   	free( right_pattern );
-  	delete [] f ;
+  	free( window_fp );
   	
    	return hits;
  	
@@ -28,30 +28,74 @@
 #include <vector>
 #include <cmath>
 #include <sys/time.h>
+#include <omp.h>
 #include <numeric>
 #include <sstream>
 #include "krfp.h"
+#include "rolling_hash.h"
 #include "rrbda-index_int.h"
 #include "unordered_dense.h"
+#include "text_view.h"
 
-#define IPS4 false
+/* Sorting backend for the fingerprints of group(): SORT_RADIX for the radix sort of radix_sort.h, or SORT_STD for std::sort. Both give the same order, and both sort groups of at least PARALLEL_GROUP members by all threads */
+#define SORT_STD 0
+#define SORT_RADIX 1
+#ifndef SORT_BACKEND
+#define SORT_BACKEND SORT_RADIX
+#endif
 
-#if IPS4 == true
-#include "../include/ips4o.hpp"
+#if SORT_BACKEND == SORT_RADIX
+#include "radix_sort.h"
+#else
+#include <parallel/algorithm>
 #endif
 
 #define DEBUG false
 #define THRESHOLD 1500000
+#define PARALLEL_GROUP 65536
+#define PREFETCH_DISTANCE 16
+
+/* Memory of sorting one suffix, in bytes, for the budget of ssa(): the suffix in A, in the groups and in the split arenas, and its SSA and LCP entries */
+#define SSA_BYTES_PER_SUFFIX 96
+/* The buckets of a budget are cut by BUCKET_SYMBOLS symbols at a time, so there are BUCKET_KEYS keys, down to BUCKET_DEPTH symbols */
+#define BUCKET_SYMBOLS 2
+#define BUCKET_KEYS ( 257 * 257 )
+#define BUCKET_DEPTH 64
 
 using namespace std;
 
-struct SSA
+/* The groups of suffixes, as flat arrays: group g extends the common prefix of its members by lcp[g] and its members are members[offset[g]..offset[g+1]). A member smaller than b is a suffix, and any other member i is the group i-b */
+struct ssa_groups
 {
-	INT lcp;
-	vector<INT> L;
-	SSA() : lcp(0), L() {}
+	vector<INT> lcp;
+	vector<INT> offset;
+	vector<INT> members;
 };
 
+/* Scratch space of one thread for splitting groups. It is kept from group to group and from round to round, so once it has grown splitting allocates nothing. done lists the groups the thread split in a round, in order, and own, news and news_size collect their results back to back */
+struct split_arena
+{
+	vector<uint64_t> fps;
+	vector<pair<uint64_t,INT>> pairs;
+	ankerl::unordered_dense::map<uint64_t, INT> ids;
+	vector<INT> grouped;
+	vector<INT> ends;
+	vector<INT> tmp;
+	vector<INT> done;
+	vector<INT> own;
+	vector<INT> news;
+	vector<INT> news_size;
+};
+
+/* Makes B a single group of the b suffixes */
+void init_groups( ssa_groups &B, INT b )
+{
+	B.lcp.assign( 1, 0 );
+	B.offset.assign( { 0, b } );
+	B.members.resize( b );
+	std::iota( B.members.begin(), B.members.end(), 0 );
+}
+
 double gettime( void )
 {
 	struct timeval ttime;
@@ -59,23 +103,25 @@ double gettime( void )
 	return ttime.tv_sec + ttime.tv_usec * 0.000001;
 };
 
-double prep_total;
-double hash_total;
-double gr_total;
-double order_total;
-double sort_total;
+/* Per thread, as the two directions of the index are sorted at the same time */
+thread_local double prep_total;
+thread_local double hash_total;
+thread_local double gr_total;
+thread_local double order_total;
 
-/* Comparator */
-auto compare(unsigned char * sequence, vector<INT> * A, INT lcp )
+/* Comparator of the symbols following the common prefix of length lcp; the end of the text ranks as symbol 0 */
+auto compare(const text_view &sequence, INT text_size, vector<INT> * A, INT lcp )
 {
-	return [sequence, A, lcp](INT a, INT b) 
+	return [sequence, text_size, A, lcp](INT a, INT b) 
 	{
-		return sequence[ A->at(a)+lcp ] < sequence[ A->at(b)+lcp ];
+		INT i = (*A)[a]+lcp;
+		INT j = (*A)[b]+lcp;
+		return ( i < text_size ? sequence[i] : 0 ) < ( j < text_size ? sequence[j] : 0 );
 	};
 }
 
 /* Compute the KR fingerprint of sequence[ssa..ssa+l-1] using the FP table -- Time is O(min(l,n/s)), where s is the size of the FP table */
-uint64_t fingerprint( INT ssa, uint64_t * FP, INT fp_len, INT l, unsigned char * sequence, INT text_size, uint64_t power )
+uint64_t fingerprint( INT ssa, uint64_t * FP, INT fp_len, INT l, const text_view &sequence, INT text_size, const karp_rabin_hashing::rolling_hash &kr )
 {
 	uint64_t fp = 0;
 	INT ssa_end = (text_size >= ssa+l) ? ssa+l : text_size; //this is the end of the substring we are interested in PLUS 1
@@ -99,7 +145,7 @@ uint64_t fingerprint( INT ssa, uint64_t * FP, INT fp_len, INT l, unsigned char *
 				start = prefix * fp_len;
 			}
 			
-			for(INT i = start; i<ssa; i++)	fp_short = karp_rabin_hashing::concat( fp_short, sequence[i], 1);
+			for(INT i = start; i<ssa; i++)	fp_short = kr.append( fp_short, sequence[i] );
 
 		}
 		else 	// we have the fp_short stored and we read it from FP
@@ -120,7 +166,7 @@ uint64_t fingerprint( INT ssa, uint64_t * FP, INT fp_len, INT l, unsigned char *
                         	fp_long = FP[prefix - 1];
                         	start = prefix * fp_len;
                         }
-                        for(INT i = start; i< ssa_end; i++)	fp_long = karp_rabin_hashing::concat( fp_long, sequence[i] , 1 );
+                        for(INT i = start; i< ssa_end; i++)	fp_long = kr.append( fp_long, sequence[i] );
                 }
                 else
                 { 
@@ -129,153 +175,335 @@ uint64_t fingerprint( INT ssa, uint64_t * FP, INT fp_len, INT l, unsigned char *
                 }
 
 		if( subtract_slow == false )
-               	 fp = karp_rabin_hashing::subtract_fast(fp_long, fp_short, power);
-                else fp = karp_rabin_hashing::subtract(fp_long, fp_short, ssa_end - ssa);
+               	 fp = kr.subtract( fp_long, fp_short );
+                else fp = kr.subtract( fp_long, fp_short, ssa_end - ssa );
 
         }
         else 
         {
-        	for(INT i=ssa; i< ssa_end; ++i)	fp =  karp_rabin_hashing::concat( fp, sequence[i], 1 );
+        	for(INT i=ssa; i< ssa_end; ++i)	fp = kr.append( fp, sequence[i] );
 	}
 
 	return fp;
 }
 
-/* Extend the prefixes of grouped suffixes by length l and re-group the computed KR fingerprints -- Time is O(b.min(l,n/s)), where s is the size of the FP table */
-INT group( vector<SSA> &B, vector<INT> * A, uint64_t * FP, INT fp_len, INT l, unsigned char * sequence, INT text_size, INT b, INT &m, INT &z, uint64_t hash_variable )
+/* Prefetch the FP entries and the first text symbols that fingerprint( ssa, ... ) reads */
+inline void prefetch_fingerprint( INT ssa, uint64_t * FP, INT fp_len, INT l, const text_view &sequence, INT text_size )
 {
-    	vector<SSA> * B_prime = new vector<SSA>();
-	(*B_prime).reserve(b); 
+	if( l > fp_len )
+	{
+		INT ssa_end = (text_size >= ssa+l) ? ssa+l : text_size;
+		INT prefix = ssa / fp_len;
+		INT prefix_end = ssa_end / fp_len;
+		if( prefix > 0 )	__builtin_prefetch( &FP[prefix - 1] );
+		if( prefix_end > 0 )	__builtin_prefetch( &FP[prefix_end - 1] );
+		__builtin_prefetch( sequence.address( prefix * fp_len ) );
+		__builtin_prefetch( sequence.address( prefix_end * fp_len ) );
+	}
+	else	__builtin_prefetch( sequence.address( ssa ) );
+}
 
-	uint64_t power = karp_rabin_hashing::pow_mod_mersenne(hash_variable, l, 61);
-	
-	const auto Bsz = B.size();
-	
-	for(INT i = 0; i<Bsz; ++i )
+/* Turn FP[j], for j < count, from the KR fingerprint of the j-th block of the text into that of the text up to the end of the block, where kr has the block length as window. The entries are split into one chunk per thread and every chunk is scanned on its own; the fingerprint of the text before each chunk is then carried into it with powers of the base, which gives exactly the table of a sequential pass */
+void prefix_scan( INT count, const karp_rabin_hashing::rolling_hash &kr, uint64_t * FP, INT threads )
+{
+	INT chunks = std::max( (INT) 1, std::min( threads, count ) );
+	vector<INT> start( chunks + 1 );
+	for(INT c = 0; c <= chunks; c++ )
+		start[c] = ( int64_t ) count * c / chunks;
+
+	#pragma omp parallel for num_threads( threads )
+	for(INT c = 0; c < chunks; c++ )
 	{
-		const INT s = (B)[i].L.size();
-		INT k = 0;	
-		vector<vector<INT>> vec;
-		vector<INT> tmp;
+		uint64_t fp = 0;
+		for(INT j = start[c]; j < start[c+1]; j++ )
+		{
+			fp = karp_rabin_hashing::rolling_hash::mod( karp_rabin_hashing::rolling_hash::mul( fp, kr.power() ) + FP[j] );
+			FP[j] = fp;
+		}
+	}
+
+	vector<uint64_t> carry( chunks, 0 );
+	for(INT c = 1; c < chunks; c++ )
+		carry[c] = kr.concat( carry[c-1], FP[start[c]-1], ( start[c] - start[c-1] ) * kr.get_window() );
+
+	#pragma omp parallel for num_threads( threads )
+	for(INT c = 1; c < chunks; c++ )
+	{
+		uint64_t shifted = karp_rabin_hashing::rolling_hash::mul( carry[c], kr.power() );
+		for(INT j = start[c]; j < start[c+1]; j++ )
+		{
+			FP[j] = karp_rabin_hashing::rolling_hash::mod( shifted + FP[j] );
+			shifted = karp_rabin_hashing::rolling_hash::mul( shifted, kr.power() );
+		}
+	}
+}
 
-		if( s <= (const INT)z )
+/* Fill FP[j], for j < count, with the KR fingerprint of sequence[0..(j+1)*fp_len), where kr has window fp_len */
+void prefix_fingerprints( const text_view &sequence, INT count, INT fp_len, const karp_rabin_hashing::rolling_hash &kr, uint64_t * FP, INT threads )
+{
+	#pragma omp parallel for num_threads( threads )
+	for(INT j = 0; j < count; j++ )
+	{
+		uint64_t fp = 0;
+		for(INT t = j * fp_len; t < ( j + 1 ) * fp_len; t++ )	fp = kr.append( fp, sequence[t] );
+		FP[j] = fp;
+	}
+
+	prefix_scan( count, kr, FP, threads );
+}
+
+/* As prefix_fingerprints(), from the fingerprints of the chunks of the text, per blocks of per_block chunks; chunk_kr has the chunk length as window. The text is not read */
+void chunk_prefix_fingerprints( const uint64_t * chunk_fp, INT count, INT per_block, const karp_rabin_hashing::rolling_hash &chunk_kr, const karp_rabin_hashing::rolling_hash &kr, uint64_t * FP, INT threads )
+{
+	#pragma omp parallel for num_threads( threads )
+	for(INT j = 0; j < count; j++ )
+	{
+		const uint64_t * chunk = &chunk_fp[ j * per_block ];
+		uint64_t fp = 0;
+		for(INT t = 0; t < per_block; t++ )
+			fp = karp_rabin_hashing::rolling_hash::mod( karp_rabin_hashing::rolling_hash::mul( fp, chunk_kr.power() ) + chunk[t] );
+		FP[j] = fp;
+	}
+
+	prefix_scan( count, kr, FP, threads );
+}
+
+/* Split the group g by the KR fingerprints of the length-l extensions of its members, appending the new member lists to the arena; only the fingerprints are computed by threads, so the result does not depend on them */
+void split_group( ssa_groups &B, INT g, split_arena &ar, INT &own_size, INT &news_count, vector<INT> * A, uint64_t * FP, INT fp_len, INT l, const text_view &sequence, INT text_size, INT z, const karp_rabin_hashing::rolling_hash &kr, INT threads )
+{
+	const INT * L = &B.members[ B.offset[g] ];
+	const INT s = B.offset[g+1] - B.offset[g];
+	const INT lcp = B.lcp[g];
+
+	/* Fingerprints are smaller than 2^61-1, so this marks the members whose extension runs past the text */
+	const uint64_t no_fp = UINT64_MAX;
+	ar.fps.resize( s );
+	uint64_t * fps = ar.fps.data();
+	/* The members start at random text positions, so their memory accesses are prefetched ahead in two stages: the entry of A of the member PREFETCH_DISTANCE after the next one, then the FP entries and text symbols of the next one, whose position is known by then */
+	#pragma omp parallel for num_threads( threads ) if( threads > 1 )
+	for(INT t = 0; t < s; t++ )
+	{
+		if( t + 2 * PREFETCH_DISTANCE < s )
+			__builtin_prefetch( &(*A)[L[t + 2 * PREFETCH_DISTANCE]] );
+		if( t + PREFETCH_DISTANCE < s )
+		{
+			INT next = (*A)[L[t + PREFETCH_DISTANCE]] + lcp;
+			if( next + l <= text_size )
+				prefetch_fingerprint( next, FP, fp_len, l, sequence, text_size );
+		}
+
+		INT pos = (*A)[L[t]] + lcp;
+		fps[t] = ( pos + l > text_size ) ? no_fp : fingerprint( pos, FP, fp_len, l, sequence, text_size, kr );
+	}
+
+	/* The members with a fingerprint are put in grouped, one subgroup after the other, and ends holds the end of every subgroup */
+	ar.tmp.clear();
+	ar.grouped.clear();
+	ar.ends.clear();
+	if( s <= z )
+	{
+		ar.pairs.clear();
+		for(INT t = 0; t < s; t++ )
+		{
+			if ( fps[t] == no_fp ) { ar.tmp.push_back(L[t]); continue; }
+			ar.pairs.push_back( make_pair(fps[t],L[t]) );
+		}
+		#if SORT_BACKEND == SORT_RADIX
+			radix_sort::parallel_sort( ar.pairs.data(), ar.pairs.size(), karp_rabin_hashing::rolling_hash::exponent, threads );
+		#else
+			if( threads > 1 )
+				__gnu_parallel::sort( ar.pairs.begin(), ar.pairs.end(), __gnu_parallel::default_parallel_tag( threads ) );
+			else
+				sort( ar.pairs.begin(), ar.pairs.end() );
+		#endif 
+
+		const INT psz = ar.pairs.size();
+		for(INT i = 0; i < psz; ++i )
+		{
+			if( i > 0 && ar.pairs[i].first != ar.pairs[i-1].first ) //if we have new group
+				ar.ends.push_back( i );
+			ar.grouped.push_back( ar.pairs[i].second );
+		}
+		if( psz > 0 )
+			ar.ends.push_back( psz );
+	}
+	else
+	{
+		/* Subgroups are numbered by first occurrence and laid out by a counting sort, which keeps the members of each in group order. Once looked up, the fingerprint of a member is replaced by its subgroup */
+		ar.ids.clear();
+		for(INT t = 0; t < s; t++ )
 		{
-			double start = gettime();
-			vector<pair<uint64_t,INT> > vec_to_sort;
-			for(auto it=(B)[i].L.begin();it!=(B)[i].L.end(); ++it)
+			if ( fps[t] == no_fp ) { ar.tmp.push_back(L[t]); continue; }
+			auto itx = ar.ids.find(fps[t]);
+			if( itx == ar.ids.end() )
 			{
-				if ( (*A)[(*it)]+(B)[i].lcp + l > text_size ) { tmp.push_back((*it)); continue; }
-				uint64_t fp = fingerprint( (*A)[(*it)]+(B)[i].lcp, FP, fp_len, l, sequence, text_size, power );
-				vec_to_sort.push_back( make_pair(fp,*it) );
+				ar.ids[fps[t]] = ar.ends.size();
+				fps[t] = ar.ends.size();
+				ar.ends.push_back( 1 );
 			}
-			#if IPS4 == true
-				ips4o::sort(vec_to_sort.begin(),vec_to_sort.end());
-			#else
-				sort(vec_to_sort.begin(),vec_to_sort.end());
-			#endif 
-
-			const auto vsz=vec_to_sort.size();
-			for(INT i=0;i<vsz;++i)
+			else
 			{
-				if (i == 0 || (i>0 && vec_to_sort[i].first != vec_to_sort[i - 1].first)) //if we have new group 
-				{
-					vector<INT> new_vec;		
-					new_vec.push_back(vec_to_sort[i].second);
-					vec.push_back(new_vec);	 //adds into vec a new vector
-					k++;
-				}
-				else	vec.back().push_back(vec_to_sort[i].second); //adds the id into the last added vector in vec
+				fps[t] = itx->second;
+				ar.ends[itx->second]++;
 			}
-			double end = gettime();
-			sort_total += end - start;
 		}
-		else
-		{	
-			double start = gettime();
-    			auto groups = ankerl::unordered_dense::map<uint64_t, INT >();
-			for(auto it=(B)[i].L.begin();it!=(B)[i].L.end(); ++it)
-			{
-				if ( (*A)[(*it)]+(B)[i].lcp + l > text_size ) { tmp.push_back((*it)); continue; }
-				uint64_t fp = fingerprint( (*A)[(*it)]+(B)[i].lcp, FP, fp_len, l, sequence, text_size, power );
-				auto itx = groups.find(fp);
-				if(itx == groups.end())
-				{
-					groups[fp] = k;
-					vector<INT> v;
-					v.push_back(*it);
-					vec.push_back(v);
-					k++;
-				}
-				else	vec[itx->second].push_back(*it);
-			}
-			groups.clear();
 
-			double end = gettime();
-			hash_total += end - start;
+		INT total = 0;
+		for( auto& size : ar.ends )
+		{
+			INT c = size;
+			size = total;
+			total += c;
 		}
+		ar.grouped.resize( total );
+		for(INT t = 0; t < s; t++ )
+			if( fps[t] != no_fp )
+				ar.grouped[ ar.ends[fps[t]]++ ] = L[t];
+
+		/* Groups this large are split only in the first rounds, so their scratch space is not kept for later ones */
+		vector<uint64_t>().swap( ar.fps );
+		ankerl::unordered_dense::map<uint64_t, INT>().swap( ar.ids );
+	}
 
-		double start = gettime();
-		
-	    	vector<INT>().swap(B[i].L);
+	const INT own_begin = ar.own.size();
+	const INT news_begin = ar.news_size.size();
+	ar.done.push_back( g );
 
-		for( INT j = 0; j < k; j++ )
-		{	
-			const auto itsz=vec[j].size();
+	INT from = 0;
+	for( auto& to : ar.ends )
+	{
+		const INT size = to - from;
+		const INT * sub = &ar.grouped[from];
 
-			if( itsz == s )
-			{
-				(B)[i].lcp += l;
-				for(const auto& value: vec[j])	(B)[i].L.push_back(value);				
+		if( size == s )
+		{
+			B.lcp[g] += l;
+			ar.own.insert( ar.own.end(), sub, sub + size );
+		}
+		else if( size >= 2 )
+		{
+			ar.news.insert( ar.news.end(), sub, sub + size );
+			ar.news_size.push_back( size );
+			ar.own.push_back( - (INT) ( ar.news_size.size() - news_begin ) );
+		}
+		else
+			ar.own.push_back( sub[0] );
 
-			}
-			else if( itsz >= 2 )
-			{
-				m++; 
-				SSA new_ssa;
+		from = to;
+	}
+	ar.own.insert( ar.own.end(), ar.tmp.begin(), ar.tmp.end() );
 
-				for(const auto& value: vec[j])	new_ssa.L.push_back(value);				
-				
-				new_ssa.lcp = (B)[i].lcp + l;
-				B_prime->push_back( new_ssa );
-				(B)[i].L.push_back(m);
+	if( s > z )
+	{
+		vector<INT>().swap( ar.grouped );
+		vector<INT>().swap( ar.ends );
+		vector<INT>().swap( ar.tmp );
+	}
 
-				A->push_back( (*A)[ vec[j][0] ] );											
-			}
-			else if ( itsz == 1 )
-			{
-				(B)[i].L.push_back( vec[j][0] );
-			}
-		}
-		for (auto& it : tmp) (B)[i].L.push_back( it );
-		vector<INT>().swap(tmp);
-		vector<vector<INT>>().swap(vec);
+	own_size = ar.own.size() - own_begin;
+	news_count = ar.news_size.size() - news_begin;
+}
 
-		double end = gettime();
-		gr_total += end - start;
+/* Extend the prefixes of grouped suffixes by length l and re-group the computed KR fingerprints, numbering the new groups as a sequential pass would -- Time is O(b.min(l,n/s)), where s is the size of the FP table */
+INT group( ssa_groups &B, vector<INT> * A, uint64_t * FP, INT fp_len, INT l, const text_view &sequence, INT text_size, INT &m, INT &z, uint64_t hash_variable, vector<split_arena> &arenas )
+{
+	karp_rabin_hashing::rolling_hash kr( hash_variable, l );
+	const INT threads = arenas.size();
+	
+	const INT Bsz = B.lcp.size();
+	for( auto& ar : arenas )
+	{
+		ar.done.clear();
+		ar.own.clear();
+		ar.news.clear();
+		ar.news_size.clear();
 	}
 
+	/* Splitting group i puts the size of its new member list in offset[i+1] and its number of new groups in first[i+1] */
+	vector<INT> first( Bsz + 1, 0 );
+	vector<INT> offset( Bsz + 1, 0 );
+
 	double start = gettime();
-	B.insert(std::end(B), std::begin(*B_prime), std::end(*B_prime));
-	delete( B_prime);
+	#pragma omp parallel for schedule(dynamic) num_threads( threads )
+	for(INT i = 0; i<Bsz; ++i )
+		if( threads == 1 || B.offset[i+1] - B.offset[i] < PARALLEL_GROUP )
+			split_group( B, i, arenas[omp_get_thread_num()], offset[i+1], first[i+1], A, FP, fp_len, l, sequence, text_size, z, kr, 1 );
+
+	for(INT i = 0; i<Bsz; ++i )
+		if( threads > 1 && B.offset[i+1] - B.offset[i] >= PARALLEL_GROUP )
+			split_group( B, i, arenas[0], offset[i+1], first[i+1], A, FP, fp_len, l, sequence, text_size, z, kr, threads );
 	double end = gettime();
+	hash_total += end - start;
+
+	start = gettime();
+	
+	/* The t-th new group of group i gets id m+1+first[i]+t, is group Bsz+first[i]+t of B, and is represented in A by its first member. Groups are laid out in B in the order of their ids */
+	for(INT i = 0; i<Bsz; ++i )
+		first[i+1] += first[i];
+	const INT total = first[Bsz];
+
+	offset.resize( Bsz + total + 1 );
+	#pragma omp parallel for num_threads( threads )
+	for(INT a = 0; a < threads; a++ )
+	{
+		const split_arena &ar = arenas[a];
+		const INT * size = ar.news_size.data();
+		for( auto& i : ar.done )
+			for( INT g = Bsz + first[i]; g < Bsz + first[i+1]; g++ )
+				offset[g+1] = *size++;
+	}
+	for(INT g = 0; g < Bsz + total; g++ )
+		offset[g+1] += offset[g];
+	
+	/* The old member lists are all in the arenas by now, so they need not be kept when B.members grows */
+	vector<INT>().swap( B.offset );
+	if( B.members.capacity() < (size_t) offset[Bsz+total] )
+		vector<INT>().swap( B.members );
+
+	A->resize( m + 1 + total );
+	B.lcp.resize( Bsz + total );
+	B.members.resize( offset[Bsz+total] );
+	
+	#pragma omp parallel for num_threads( threads )
+	for(INT a = 0; a < threads; a++ )
+	{
+		const split_arena &ar = arenas[a];
+		const INT * own = ar.own.data();
+		const INT * news = ar.news.data();
+		for( auto& i : ar.done )
+		{
+			const INT first_id = m + 1 + first[i];
+			INT * out = &B.members[ offset[i] ];
+			for( INT t = 0; t < offset[i+1] - offset[i]; t++ )
+				out[t] = ( own[t] < 0 ) ? first_id - own[t] - 1 : own[t];
+			own += offset[i+1] - offset[i];
+
+			for( INT g = Bsz + first[i]; g < Bsz + first[i+1]; g++ )
+			{
+				const INT size = offset[g+1] - offset[g];
+				std::copy( news, news + size, &B.members[ offset[g] ] );
+				B.lcp[g] = B.lcp[i] + l;
+				(*A)[ m + 1 + g - Bsz ] = (*A)[ news[0] ];
+				news += size;
+			}
+		}
+	}
+	B.offset.swap( offset );
+	m += total;
+	
+	end = gettime();
 	gr_total += end - start;
 
 	return 0;
 }
 
 /* Sort the final group members and infer the SSA and SLCP array -- Time is O(b log b) */
-INT order( vector<INT> * final_ssa, vector<INT> * final_lcp, vector<SSA> &B, vector<INT> * A, unsigned char * sequence, INT text_size, INT b )
+INT order( vector<INT> * final_ssa, vector<INT> * final_lcp, ssa_groups &B, vector<INT> * A, const text_view &sequence, INT text_size, INT b )
 {
 
-	const INT Bsz=B.size();
+	const INT Bsz=B.lcp.size();
 	for(INT i = 0; i<Bsz; i++)
-	{	
-		#if IPS4 == true
-			ips4o::sort((B)[i].L.begin(), (B)[i].L.end(), compare(sequence,A,(B)[i].lcp));
-		#else
-			sort((B)[i].L.begin(), (B)[i].L.end(), compare(sequence,A,(B)[i].lcp));
-		#endif		
-	}
+		sort(B.members.begin() + B.offset[i], B.members.begin() + B.offset[i+1], compare(sequence,text_size,A,B.lcp[i]));
 	stack<pair<INT,INT>> S; 
 	
 	S.push( make_pair<INT, INT>((INT)b, 0) );  //b is the correct first index, not b+1
@@ -293,11 +521,10 @@ INT order( vector<INT> * final_ssa, vector<INT> * final_lcp, vector<SSA> &B, vec
 
 		if(i>=b) //it is not one of the initial groups
 		{
-			INT lcp = (B)[i-b].lcp;
-			auto myl=(B)[i-b].L;
-			for(vector<INT>::reverse_iterator it=myl.rbegin();it!=myl.rend();++it)
+			INT lcp = B.lcp[i-b];
+			for(INT t = B.offset[i-b+1]; t > B.offset[i-b]; t--)
 			{				  					
-				S.push(make_pair<INT, INT>( (INT) *it, (INT) lcp ));
+				S.push(make_pair<INT, INT>( (INT) B.members[t-1], (INT) lcp ));
 			}
 		}
 		else
@@ -311,92 +538,106 @@ INT order( vector<INT> * final_ssa, vector<INT> * final_lcp, vector<SSA> &B, vec
 	return 0;
 }
 
+/* Key of the BUCKET_SYMBOLS symbols that follow the first depth symbols of the suffix at i: a symbol c counts as c+1 and the end of the text as 0, so that the keys are in the order of the suffixes */
+inline INT bucket_key( const text_view &sequence, INT text_size, INT i, INT depth )
+{
+	INT key = 0;
+	for( INT j = i + depth; j < i + depth + BUCKET_SYMBOLS; j++ )
+		key = key * 257 + ( j < text_size ? sequence[j] + 1 : 0 );
+	return key;
+}
 
-INT ssa(unsigned char * sequence, INT text_size, vector<INT> * ssa_list , string sa_index_name, string lcp_index_name, vector<INT> * final_ssa, vector<INT> * final_lcp, uint64_t hash_variable )
+/* Orders the suffixes of list[from..to), which share their first depth symbols, in place by their next BUCKET_SYMBOLS symbols, and cuts them into buckets of consecutive keys of at most capacity suffixes, appended to buckets in the order of the suffixes; the suffixes of a key that has more are cut by the symbols that follow, down to BUCKET_DEPTH symbols -- Time is O(to-from) per level */
+void partition_suffixes( const text_view &sequence, INT text_size, INT * list, INT from, INT to, INT depth, INT capacity, vector<pair<INT,INT>> &buckets )
 {
-	INT z = THRESHOLD;
+	if( to - from <= capacity || depth >= BUCKET_DEPTH )
+	{
+		buckets.push_back( make_pair( from, to ) );
+		return;
+	}
 
-	INT b = ssa_list->size();
-	cout<<"Number of suffixes b = " << b << endl;
-	
-	INT s = 2*b;
-	if ( s > text_size ) s = text_size;
-	INT fp_len = text_size / s;
-	if ( (text_size - fp_len * s) > text_size/s ) 
-		s = text_size/fp_len; 
-	cout<<"Block length = "<<fp_len<<endl;
-	cout<<"Size s of FP table = " << s <<endl<<endl;
-	
-	// computing fingerprints
-	uint64_t * FP =  ( uint64_t * ) calloc( s , sizeof( uint64_t ) );
-	uint64_t fp = 0;
-	
-	std::chrono::steady_clock::time_point start_total = std::chrono::steady_clock::now();
-	
-	prep_total = 0;
-	double start = gettime();
-	cout<<"Preprocessing starts"<<endl;
-	INT i = 0;
-	for(uint64_t j = 0; j < s; ++j )
+	vector<INT> end( BUCKET_KEYS + 1, 0 );
+	for( INT i = from; i < to; i++ )
+		end[ bucket_key( sequence, text_size, list[i], depth ) + 1 ]++;
+	end[0] = from;
+	for( INT k = 1; k <= BUCKET_KEYS; k++ )
+		end[k] += end[k-1];
+
+	/* Every suffix is swapped into the next free place of its key, so next[k] ends up at the end of key k, end[k+1] */
+	vector<INT> next( end.begin(), end.end() - 1 );
+	for( INT k = 0; k < BUCKET_KEYS; k++ )
+		while( next[k] < end[k+1] )
+		{
+			INT suffix = list[ next[k] ];
+			INT key = bucket_key( sequence, text_size, suffix, depth );
+			while( key != k )
+			{
+				std::swap( suffix, list[ next[key]++ ] );
+				key = bucket_key( sequence, text_size, suffix, depth );
+			}
+			list[ next[k]++ ] = suffix;
+		}
+	vector<INT>().swap( next );
+
+	/* The open bucket starts at start */
+	INT start = from;
+	for( INT k = 0; k < BUCKET_KEYS; k++ )
 	{
-		for (uint64_t k = 0; k < fp_len; k ++ )fp = karp_rabin_hashing::concat(fp, sequence[i+k], 1);
-			FP[j]=fp;
-		i += fp_len;
-		if ( i + fp_len > text_size ) break;
+		INT key_from = end[k];
+		INT key_to = end[k+1];
+		if( key_to - key_from > capacity )
+		{
+			if( key_from > start )
+				buckets.push_back( make_pair( start, key_from ) );
+			partition_suffixes( sequence, text_size, list, key_from, key_to, depth + BUCKET_SYMBOLS, capacity, buckets );
+			start = key_to;
+		}
+		else if( key_to - start > capacity )
+		{
+			buckets.push_back( make_pair( start, key_from ) );
+			start = key_from;
+		}
 	}
-	cout<<"Preprocessing ends"<<endl<<endl;
-	double end = gettime();
-	prep_total = end - start;
+	if( to > start )
+		buckets.push_back( make_pair( start, to ) );
+}
+
+/* Sorts the suffixes A[0..b), where b is the size of A, into final_ssa and final_lcp, which are empty, using the FP table of blocks of length fp_len */
+void sort_suffixes( const text_view &sequence, INT text_size, vector<INT> * A, vector<INT> * final_ssa, vector<INT> * final_lcp, uint64_t * FP, INT fp_len, uint64_t hash_variable, INT threads )
+{
+	INT z = THRESHOLD;
+	INT b = A->size();
+	const INT b_initial = b;
 
-    	vector<SSA> B;
+    	ssa_groups B;
+	vector<split_arena> arenas( threads );
 
-	vector<INT> * A = new vector<INT>();
-	
+	/* The anchors themselves are the first b entries of A; the representatives of new groups are appended after them and dropped at the end */
 	vector<INT> * A_prime = new vector<INT>();
 	vector<INT> * P = new vector<INT>();
 	
-	vector<INT> L;
+	init_groups( B, b );
 
-	const auto ssa_list_sz=ssa_list->size();
-	for(INT i = 0; i<ssa_list_sz; ++i )
-	{	
-		A->push_back( (*ssa_list)[i] );
-		L.push_back(i);
-	}
-	
-	SSA initial;
-	initial.lcp = 0;
-	
-    	initial.L.assign(L.begin(), L.end()); 
-
-	B.push_back( initial );
+	A->push_back( (*A)[0] );
+	INT m = b;
 
-	A->push_back( (*ssa_list)[0] );
-	INT m = ssa_list->size();
-
-	hash_total = 0;
-	gr_total = 0;
-	
 	INT c1 = 1;
 	INT initial_l = 1ULL << static_cast<INT>(log2(c1*text_size/b));
 	INT next_initial_l = initial_l * 2 - 1;
-	//vector<INT> * final_ssa = new vector<INT>();
-	//vector<INT> * final_lcp = new vector<INT>();
 	
 	cout<<"First run starts"<<endl;
 	while( initial_l > 0 )
 	{
 		cout<< "Initial l: " << initial_l <<", nodes: "<< m <<endl;
-		group( B, A, FP, fp_len, initial_l, sequence, text_size, b, m, z, hash_variable );
+		group( B, A, FP, fp_len, initial_l, sequence, text_size, m, z, hash_variable, arenas );
 		initial_l=initial_l>>1;	
 	}	
+	arenas.assign( threads, split_arena() );
 		
-	order_total = 0;
-	start = gettime();
-	
+	double start = gettime();
 	order( final_ssa, final_lcp, B, A, sequence, text_size, b);	
-	end = gettime();
-	order_total = end - start;
+	double end = gettime();
+	order_total += end - start;
 	cout<<"First run ends"<<endl<<endl;
 	
 	for(INT i = 0; i<b; i++)
@@ -418,34 +659,30 @@ INT ssa(unsigned char * sequence, INT text_size, vector<INT> * ssa_list , string
 		cout<<"Second run starts"<<endl;
 		
 		INT l = 1ULL << static_cast<INT>(log2(text_size));
-		vector<SSA>().swap(B);
+
+		/* The groups of the first run are far larger than those of the second, so their space is released */
+		B = ssa_groups();
 
 		b = A_prime->size();
 		m = A_prime->size();
 		
-		vector<INT> L(m); 
-	    	std::iota(L.begin(), L.end(), 0); 
-
-		SSA initial;
-		initial.lcp = 0;
-		initial.L.assign(L.begin(), L.end()); 
-		
-		B.push_back( initial );
+		init_groups( B, b );
 		A_prime->push_back( (*A_prime)[0] );
 		
 		while( l > 0 )
 		{	
 			cout<< "l: " << l <<", nodes: "<< m <<endl;
-			group( B, A_prime, FP, fp_len, l, sequence, text_size, b, m, z, hash_variable );
+			group( B, A_prime, FP, fp_len, l, sequence, text_size, m, z, hash_variable, arenas );
 			l=l>>1;
 		}	
+		arenas.assign( threads, split_arena() );
 		
 		start = gettime();
 		order( final_ssa_prime, final_lcp_prime, B, A_prime, sequence, text_size, b);
 		end = gettime();
 		order_total += end - start;
 		
-		const auto Psz=P->size();	
+		const INT Psz=P->size();	
 		for(INT i = 0; i<Psz; ++i)
 		{
 			(*final_ssa) [(*P)[i] ] = (*final_ssa_prime)[i];
@@ -456,24 +693,120 @@ INT ssa(unsigned char * sequence, INT text_size, vector<INT> * ssa_list , string
 		cout<<"Second run ends"<<endl;
 	}
 	
-	free( FP );
-	
-	std::chrono::steady_clock::time_point end_total = std::chrono::steady_clock::now();
-
-	ofstream output_ssa(sa_index_name);
-	for(INT i = 0; i<final_ssa->size(); i++)
-		output_ssa<<final_ssa->at(i)<<endl;
-	
-	ofstream output_lcp(lcp_index_name);
-	for(INT i = 0; i<final_lcp->size(); i++)
-		output_lcp<<final_lcp->at(i)<<endl;
-	
 	delete( final_lcp_prime );
 	delete( final_ssa_prime );
-	delete( A );
+	A->resize( b_initial );
 	delete( A_prime );
 	delete( P );
+}
+
+/* Sorts the suffixes of ssa_list into final_ssa and final_lcp, in buckets kept in the file spill_name if they need more than memory bytes (0 for none) */
+INT ssa(const text_view &sequence, INT text_size, vector<INT> * ssa_list , string spill_name, vector<INT> * final_ssa, vector<INT> * final_lcp, uint64_t hash_variable, INT threads, double fp_bytes, const vector<uint64_t> * chunk_fp, INT chunk_len, INT memory )
+{
+	INT b = ssa_list->size();
+	cout<<"Number of suffixes b = " << b << endl;
+	
+	/* The FP table has two entries per suffix, or fp_bytes bytes per text symbol if that is more; a fingerprint costs O(n/s) time, and O(1) when every prefix has an entry */
+	INT s = 2*b;
+	INT budget = fp_bytes * text_size / sizeof( uint64_t );
+	if ( budget > s ) s = budget;
+	if ( s > text_size ) s = text_size;
+	INT fp_len = text_size / s;
+	if ( (text_size - fp_len * s) > text_size/s ) 
+		s = text_size/fp_len; 
+
+	/* The chunk fingerprints of the anchor phase give the FP table without reading the text if the blocks are made of whole chunks */
+	bool from_chunks = ( chunk_fp != NULL && fp_len >= chunk_len );
+	if ( from_chunks && fp_len % chunk_len != 0 )
+	{
+		fp_len -= fp_len % chunk_len;
+		s = text_size / fp_len;
+	}
+	cout<<"Block length = "<<fp_len<<endl;
+	cout<<"Size s of FP table = " << s <<endl<<endl;
+	
+	// computing fingerprints
+	uint64_t * FP =  ( uint64_t * ) calloc( s , sizeof( uint64_t ) );
+	
+	prep_total = 0;
+	double start = gettime();
+	cout<<"Preprocessing starts"<<( from_chunks ? " (from the chunk fingerprints)" : "" )<<endl;
+	karp_rabin_hashing::rolling_hash kr( hash_variable, fp_len );
+	if( from_chunks )
+		chunk_prefix_fingerprints( chunk_fp->data(), std::min( s, text_size / fp_len ), fp_len / chunk_len, karp_rabin_hashing::rolling_hash( hash_variable, chunk_len ), kr, FP, threads );
+	else
+		prefix_fingerprints( sequence, std::min( s, text_size / fp_len ), fp_len, kr, FP, threads );
+	cout<<"Preprocessing ends"<<endl<<endl;
+	double end = gettime();
+	prep_total = end - start;
+
+	hash_total = 0;
+	gr_total = 0;
+	order_total = 0;
+	
+	/* Under the budget, ssa_list is partitioned in place into buckets of at most memory/SSA_BYTES_PER_SUFFIX suffixes and moved to the spill file, where every sorted bucket overwrites its suffixes and puts its LCP values b entries further */
+	if( memory == 0 || memory >= SSA_BYTES_PER_SUFFIX * b )
+	{
+		sort_suffixes( sequence, text_size, ssa_list, final_ssa, final_lcp, FP, fp_len, hash_variable, threads );
+		free( FP );
+	}
+	else
+	{
+		INT capacity = std::max( ( INT ) 1, memory / SSA_BYTES_PER_SUFFIX );
+		vector<pair<INT,INT>> buckets;
+		partition_suffixes( sequence, text_size, ssa_list->data(), 0, b, 0, capacity, buckets );
+
+		std::FILE * spill = utils::file_open( spill_name, "w+" );
+		utils::add_objects_to_file( spill, b, ssa_list->data() );
+		vector<INT>().swap( *ssa_list );
+		cout<<"The suffixes are sorted in "<<buckets.size()<<" buckets of at most "<<capacity<<" suffixes, which are kept in "<<spill_name<<endl<<endl;
+
+		INT last = 0;
+		for( INT i = 0; i < (INT) buckets.size(); i++ )
+		{
+			INT from = buckets[i].first;
+			INT to = buckets[i].second;
+			cout<<"Bucket "<<i+1<<" of "<<buckets.size()<<": "<<to-from<<" suffixes"<<endl;
+
+			/* The suffixes of a bucket are sorted in text order, in which the first rounds read the text */
+			vector<INT> * bucket = new vector<INT>( to - from );
+			utils::read_objects_at_offset( spill, from, to - from, bucket->data() );
+			sort( bucket->begin(), bucket->end() );
+
+			vector<INT> * bucket_ssa = new vector<INT>();
+			vector<INT> * bucket_lcp = new vector<INT>();
+			sort_suffixes( sequence, text_size, bucket, bucket_ssa, bucket_lcp, FP, fp_len, hash_variable, threads );
+
+			/* The last suffix of the previous bucket and the first of this one differ in the symbols the buckets were cut by, so their LCP is found by comparing them */
+			if( i > 0 )
+			{
+				INT y = (*bucket_ssa)[0];
+				INT lcp = 0;
+				while( last + lcp < text_size && y + lcp < text_size && sequence[last + lcp] == sequence[y + lcp] )
+					lcp++;
+				(*bucket_lcp)[0] = lcp;
+			}
+			last = bucket_ssa->back();
+
+			utils::write_objects_at_offset( spill, from, to - from, bucket_ssa->data() );
+			utils::write_objects_at_offset( spill, b + from, to - from, bucket_lcp->data() );
+			delete( bucket_lcp );
+			delete( bucket_ssa );
+			delete( bucket );
+		}
+		free( FP );
+
+		final_ssa->resize( b );
+		final_lcp->resize( b );
+		utils::read_objects_at_offset( spill, 0, b, final_ssa->data() );
+		utils::read_objects_at_offset( spill, b, b, final_lcp->data() );
+		std::fclose( spill );
+		utils::file_delete( spill_name );
+
+		/* ssa_list is given back its suffixes, in text order */
+		*ssa_list = *final_ssa;
+		sort( ssa_list->begin(), ssa_list->end() );
+	}
 	
 	return 0;
 }
-